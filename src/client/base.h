@@ -29,12 +29,13 @@
 #include <sstream>
 #include <assert.h>
 #include <atomic>
+#include <deque>
 #include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 
-using ShadowMap = std::unordered_map<uintptr_t, IUnknown*>;
-extern ShadowMap gShadowMap;
-
-extern std::mutex gShadowMapMutex;
+#include "shadow_map.h"
 
 enum class D3D9ObjectType: char {
   Module,
@@ -301,11 +302,19 @@ static inline D3DAutoPtr MakeD3DAutoPtr(T* obj) {
   return D3DAutoPtr(static_cast<D3DRefCounted*>(obj));
 }
 
+// Assigns the handles the server uses to refer to client objects. Handles follow
+// the bridge_util::Handle layout: a dense slot index plus a generation counter.
+// Released indices are reused in FIFO order, and only once enough of them are
+// free, to keep handles of recently destroyed objects from being reissued soon.
 class D3dBaseIdFactory {
 private:
-  static std::atomic<uintptr_t> id_counter;
+  static constexpr size_t kMinFreeIndices = 1024;
+  static std::mutex s_mutex;
+  static std::vector<uint16_t> s_generations;
+  static std::deque<uint32_t> s_freeIndices;
 public:
   static uintptr_t getNextId();
+  static void releaseId(const uintptr_t id);
 };
 
 // The base object for every D3D object. Implements IUnknown::AddRef() and
@@ -374,9 +383,8 @@ protected:
   }
 
   ~D3DBase() override {
-    gShadowMapMutex.lock();
     gShadowMap.erase(m_id);
-    gShadowMapMutex.unlock();
+    D3dBaseIdFactory::releaseId(m_id);
 #ifdef _DEBUG
     Logger::debug(format_string("%s object [%p/%p] destroyed",
                                 toD3D9ObjectTypeName<T>(), this, m_id));
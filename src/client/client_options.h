@@ -78,4 +78,54 @@ namespace ClientOptions {
   inline bool getOptimizedDynamicLock() {
     return bridge_util::Config::getOption<bool>("client.optimizedDynamicLock", false);
   }
+
+  // If set, D3DLOCK_NOOVERWRITE updates of dynamic buffers are not sent on Unlock.
+  // Instead the written ranges are merged and the union is sent right before the
+  // buffer is consumed by a draw call, or when the buffer is locked without
+  // D3DLOCK_NOOVERWRITE. Has no effect when client.optimizedDynamicLock is set.
+  inline bool getCoalesceNoOverwriteLocks() {
+    return bridge_util::Config::getOption<bool>("client.coalesceNoOverwriteLocks", false);
+  }
+
+  // If set, vertex declarations created from identical element arrays share one
+  // declaration object, so only the first of them is created on the server.
+  inline bool getInternVertexDeclarations() {
+    return bridge_util::Config::getOption<bool>("client.internVertexDeclarations", false);
+  }
+
+  // If set, the server is launched on a background thread as soon as the client
+  // is attached, rather than when the game first calls Direct3DCreate9.
+  inline bool getEagerServerLaunch() {
+    return bridge_util::Config::getOption<bool>("client.eagerServerLaunch", true);
+  }
+
+  // Sends Remix API DrawInstance calls to the server in batches
+  inline bool getRemixApiInstanceBatching() {
+    return bridge_util::Config::getOption<bool>("client.remixApiInstanceBatching", true);
+  }
+
+  // Surface readbacks land in a SharedHeap allocation the surface adopts
+  inline bool getSharedHeapReadback() {
+    return bridge_util::Config::getOption<bool>("client.sharedHeapReadback", true);
+  }
+
+  // Event, occlusion and timestamp query results are pushed by the server
+  inline bool getQueryResultPush() {
+    return bridge_util::Config::getOption<bool>("client.queryResultPush", true);
+  }
+
+  // Remix API payloads at least this large are serialized into the SharedHeap
+  inline uint32_t getRemixApiSharedHeapThreshold() {
+    return bridge_util::Config::getOption<uint32_t>("client.remixApiSharedHeapThreshold", 64 * 1024);
+  }
+
+  // Memoizes the results of adapter, caps and format queries on the client
+  inline bool getQueryCache() {
+    return bridge_util::Config::getOption<bool>("client.queryCache", true);
+  }
+
+  // Persists the memoized query results to disk for reuse by later runs
+  inline bool getPersistQueryCache() {
+    return bridge_util::Config::getOption<bool>("client.persistQueryCache", false);
+  }
 }
\ No newline at end of file
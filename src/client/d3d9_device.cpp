@@ -35,6 +35,8 @@
 #include "d3d9_vertexdeclaration.h"
 #include "d3d9_vertexshader.h"
 #include "d3d9_volumetexture.h"
+#include "module_query_cache.h"
+#include "present_pacer.h"
 #include "shadow_map.h"
 #include "client_options.h"
 #include "swapchain_map.h"
@@ -43,10 +45,13 @@
 #include "window.h"
 
 #include "util_bridge_assert.h"
+#include "util_hash.h"
+#include "util_metrics.h"
 #include "util_semaphore.h"
 
 #include <wingdi.h>
 #include <assert.h>
+#include <chrono>
 
 #define GET_PRES_PARAM() (m_pSwapchain->getPresentationParameters())
 
@@ -444,6 +449,9 @@ HRESULT Direct3DDevice9Ex_LSS<EnableSync>::Reset(D3DPRESENT_PARAMETERS* pPresent
       DeviceBridge::pop_front();
       }
 
+    // The reset may have switched the display mode
+    ModuleQueryCache::invalidateDisplayModes("device reset");
+
     // Reset swapchain and link server backbuffer/depth buffer after the server reset its swapchain, or we will link to the old backbuffer/depth resources
     initImplicitObjects(presParam);
     // Keeping a track of previous present parameters, to detect and handle mode changes
@@ -458,12 +466,18 @@ HRESULT syncOnPresent() {
 #endif
 
   // If we're syncing with the server on Present() then wait for the semaphore to be released
+  if (GlobalOptions::getPresentSemaphoreEnabled() && GlobalOptions::getAdaptivePresentPacing()) {
+    return PresentPacer::onPresent(*gpPresent);
+  }
   if (GlobalOptions::getPresentSemaphoreEnabled()) {
     const auto maxRetries = GlobalOptions::getCommandRetries();
     size_t numRetries = 0;
+    const auto waitStart = std::chrono::steady_clock::now();
     while (gbBridgeRunning && RESULT_FAILURE(gpPresent->wait()) && numRetries++ < maxRetries) {
       Logger::warn("Still waiting on the Present semaphore to be released...");
     }
+    Metrics::addPresentWait(std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - waitStart).count());
     if (numRetries >= maxRetries) {
       Logger::err("Max retries reached waiting on the Present semaphore!");
       return ERROR_SEM_TIMEOUT;
@@ -834,12 +848,24 @@ HRESULT Direct3DDevice9Ex_LSS<EnableSync>::GetRenderTargetData(IDirect3DSurface9
   const auto pLssSourceSurface = bridge_cast<Direct3DSurface9_LSS*>(pRenderTarget);
   const auto pLssDestinationSurface = bridge_cast<Direct3DSurface9_LSS*>(pDestSurface);
 
+  // With a SharedHeap readback the data is only waited for when the
+  // destination is locked
+  const bool bReadback =
+    pLssDestinationSurface->canReadbackRenderTarget(pLssSourceSurface) &&
+    pLssDestinationSurface->prepareReadback();
   UID currentUID = 0;
   {
-    ClientMessage c(Commands::IDirect3DDevice9Ex_GetRenderTargetData, getId());
+    ClientMessage c(Commands::IDirect3DDevice9Ex_GetRenderTargetData, getId(),
+                    bReadback ? Direct3DSurface9_LSS::kReadbackFlags : 0);
     currentUID = c.get_uid();
     c.send_data(pLssSourceSurface->getId());
     c.send_data(pLssDestinationSurface->getId());
+    if (bReadback) {
+      pLssDestinationSurface->sendReadbackTarget(c);
+    }
+  }
+  if (bReadback) {
+    return D3D_OK;
   }
 
   // Wait for response from server
@@ -857,12 +883,26 @@ HRESULT Direct3DDevice9Ex_LSS<EnableSync>::GetFrontBufferData(UINT iSwapChain, I
 
   const auto pLssDestinationSurface = bridge_cast<Direct3DSurface9_LSS*>(pDestSurface);
 
+  bool bCanReadback = false;
+  if (iSwapChain == 0) {
+    BRIDGE_DEVICE_LOCKGUARD();
+    bCanReadback = m_pSwapchain != nullptr &&
+      pLssDestinationSurface->canReadbackFrontBuffer(m_pSwapchain->getPresentationParameters());
+  }
+  const bool bReadback = bCanReadback && pLssDestinationSurface->prepareReadback();
   UID currentUID = 0;
   {
     // Direct API call to server
-    ClientMessage c(Commands::IDirect3DDevice9Ex_GetFrontBufferData, getId());
+    ClientMessage c(Commands::IDirect3DDevice9Ex_GetFrontBufferData, getId(),
+                    bReadback ? Direct3DSurface9_LSS::kReadbackFlags : 0);
     currentUID = c.get_uid();
     c.send_many(iSwapChain, pLssDestinationSurface->getId());
+    if (bReadback) {
+      pLssDestinationSurface->sendReadbackTarget(c);
+    }
+  }
+  if (bReadback) {
+    return D3D_OK;
   }
 
   return copyServerSurfaceRawData(pLssDestinationSurface, currentUID);
@@ -1632,17 +1672,11 @@ void Direct3DDevice9Ex_LSS<EnableSync>::StateBlockSetPixelCaptureFlags(BaseDirec
     flags.samplerStates[i][D3DSAMP_SRGBTEXTURE] = true;
     flags.samplerStates[i][D3DSAMP_ELEMENTINDEX] = true;
   }
-  for (auto& fConst : flags.pixelConstants.fConsts) {
-    fConst = true;
-  }
-  for (auto& iConst : flags.pixelConstants.iConsts) {
-    iConst = true;
-  }
-  for (auto& bConst : flags.pixelConstants.bConsts) {
-    bConst = true;
-  }
+  flags.pixelConstants.fConsts.set();
+  flags.pixelConstants.iConsts.set();
+  flags.pixelConstants.bConsts.set();
   for (auto& stage : flags.textureStageStates) {
-    std::fill(std::begin(stage), std::end(stage), true);
+    stage.set();
   }
 }
 
@@ -1695,26 +1729,16 @@ void Direct3DDevice9Ex_LSS<EnableSync>::StateBlockSetVertexCaptureFlags(BaseDire
   flags.renderStates[D3DRS_SHADEMODE] = true;
 
   flags.vertexDecl = true;
-  std::fill(std::begin(flags.streamFreqs), std::end(flags.streamFreqs), true);
+  flags.streamFreqs.set();
   // Lights in the map are always transferred if they exist 
   // LightEnables in the map are always transferred if they exist 
   for (uint32_t i = caps::MaxTexturesPS + 1; i < BaseDirect3DDevice9Ex_LSS::kMaxStageSamplerStateTypes; i++) {
     flags.samplerStates[i][D3DSAMP_DMAPOFFSET] = true;
   }
 
-  for (auto& fConst : flags.vertexConstants.fConsts) {
-    fConst = true;
-  }
-  for (auto& iConst : flags.vertexConstants.iConsts) {
-    iConst = true;
-  }
-  for (auto& bConst : flags.vertexConstants.bConsts) {
-    bConst = true;
-  }
-
-  for (uint32_t i = 0; i < flags.streamFreqs.size(); i++) {
-    flags.streamFreqs[i] = true;
-  }
+  flags.vertexConstants.fConsts.set();
+  flags.vertexConstants.iConsts.set();
+  flags.vertexConstants.bConsts.set();
 
 }
 
@@ -1727,17 +1751,17 @@ void Direct3DDevice9Ex_LSS<EnableSync>::StateBlockSetCaptureFlags(D3DSTATEBLOCKT
     StateBlockSetVertexCaptureFlags(flags);
   }
   if (Type == D3DSBT_ALL) {
-    std::fill(std::begin(flags.textures), std::end(flags.textures), true);
-    std::fill(std::begin(flags.streams), std::end(flags.streams), true);
-    std::fill(std::begin(flags.streamOffsetsAndStrides), std::end(flags.streamOffsetsAndStrides), true);
+    flags.textures.set();
+    flags.streams.set();
+    flags.streamOffsetsAndStrides.set();
 
     flags.indices = true;
     flags.viewport = true;
     flags.scissorRect = true;
 
-    std::fill(std::begin(flags.clipPlanes), std::end(flags.clipPlanes), true);
+    flags.clipPlanes.set();
 
-    std::fill(std::begin(flags.transforms), std::end(flags.transforms), true);
+    flags.transforms.set();
 
     flags.material = true;
   }
@@ -2332,11 +2356,30 @@ float Direct3DDevice9Ex_LSS<EnableSync>::GetNPatchMode() {
   return result;
 }
 
+template<bool EnableSync>
+void Direct3DDevice9Ex_LSS<EnableSync>::flushPendingBufferUpdates(const bool bIndexed) {
+  if (!m_bCoalesceNoOverwrite) {
+    return;
+  }
+  BRIDGE_DEVICE_LOCKGUARD();
+  for (auto& stream : m_state.streams) {
+    if (auto* const pLssVertexBuffer = bridge_cast<Direct3DVertexBuffer9_LSS*>(*stream)) {
+      pLssVertexBuffer->flushPendingRanges();
+    }
+  }
+  if (bIndexed) {
+    if (auto* const pLssIndexBuffer = bridge_cast<Direct3DIndexBuffer9_LSS*>(*m_state.indices)) {
+      pLssIndexBuffer->flushPendingRanges();
+    }
+  }
+}
+
 template<bool EnableSync>
 HRESULT Direct3DDevice9Ex_LSS<EnableSync>::DrawPrimitive(D3DPRIMITIVETYPE PrimitiveType, UINT StartVertex, UINT PrimitiveCount) {
   ZoneScoped;
   LogFunctionCall();
   UID currentUID = 0;
+  flushPendingBufferUpdates(false);
   {
     ClientMessage c(Commands::IDirect3DDevice9Ex_DrawPrimitive, getId());
     currentUID = c.get_uid();
@@ -2350,6 +2393,7 @@ HRESULT Direct3DDevice9Ex_LSS<EnableSync>::DrawIndexedPrimitive(D3DPRIMITIVETYPE
   ZoneScoped;
   LogFunctionCall();
   UID currentUID = 0;
+  flushPendingBufferUpdates(true);
   {
     ClientMessage c(Commands::IDirect3DDevice9Ex_DrawIndexedPrimitive, getId());
     currentUID = c.get_uid();
@@ -2363,15 +2407,14 @@ HRESULT Direct3DDevice9Ex_LSS<EnableSync>::DrawPrimitiveUP(D3DPRIMITIVETYPE Prim
   ZoneScoped;
   LogFunctionCall();
   UID currentUID = 0;
+  const uint32_t numIndices = GetIndexCount(PrimitiveType, PrimitiveCount);
+  const uint32_t vertexDataSize = numIndices * VertexStreamZeroStride;
+  const auto vertexStreamId = DeviceBridge::send_stream_if_oversized(vertexDataSize, pVertexStreamZeroData);
   {
     ClientMessage c(Commands::IDirect3DDevice9Ex_DrawPrimitiveUP, getId());
     currentUID = c.get_uid();
     c.send_many(PrimitiveType, PrimitiveCount);
-
-    uint32_t numIndices = GetIndexCount(PrimitiveType, PrimitiveCount);
-    uint32_t vertexDataSize = numIndices * VertexStreamZeroStride;
-
-    c.send_data(vertexDataSize, (void*) pVertexStreamZeroData);
+    c.send_data_or_stream(vertexStreamId, vertexDataSize, (void*) pVertexStreamZeroData);
     c.send_data(VertexStreamZeroStride);
   }
   WAIT_FOR_OPTIONAL_SERVER_RESPONSE("DrawPrimitiveUP()", D3DERR_INVALIDCALL, currentUID);
@@ -2382,18 +2425,18 @@ HRESULT Direct3DDevice9Ex_LSS<EnableSync>::DrawIndexedPrimitiveUP(D3DPRIMITIVETY
   ZoneScoped;
   LogFunctionCall();
   UID currentUID = 0;
+  const uint32_t numIndices = GetIndexCount(PrimitiveType, PrimitiveCount);
+  const uint32_t indexStride = IndexDataFormat == D3DFMT_INDEX16 ? 2 : 4;
+  const uint32_t indexDataSize = numIndices * indexStride;
+  const uint32_t vertexDataSize = NumVertices * VertexStreamZeroStride;
+  const auto indexStreamId = DeviceBridge::send_stream_if_oversized(indexDataSize, pIndexData);
+  const auto vertexStreamId = DeviceBridge::send_stream_if_oversized(vertexDataSize, pVertexStreamZeroData);
   {
     ClientMessage c(Commands::IDirect3DDevice9Ex_DrawIndexedPrimitiveUP, getId());
     currentUID = c.get_uid();
     c.send_many(PrimitiveType, MinIndex, NumVertices, PrimitiveCount, IndexDataFormat, VertexStreamZeroStride);
-
-    uint32_t numIndices = GetIndexCount(PrimitiveType, PrimitiveCount);
-    uint32_t indexStride = IndexDataFormat == D3DFMT_INDEX16 ? 2 : 4;
-    uint32_t indexDataSize = numIndices * indexStride;
-    uint32_t vertexDataSize = NumVertices * VertexStreamZeroStride;
-
-    c.send_data(indexDataSize, (void*) pIndexData);
-    c.send_data(vertexDataSize, (void*) pVertexStreamZeroData);
+    c.send_data_or_stream(indexStreamId, indexDataSize, (void*) pIndexData);
+    c.send_data_or_stream(vertexStreamId, vertexDataSize, (void*) pVertexStreamZeroData);
   }
   WAIT_FOR_OPTIONAL_SERVER_RESPONSE("DrawIndexedPrimitiveUP()", D3DERR_INVALIDCALL, currentUID);
 }
@@ -2408,11 +2451,20 @@ HRESULT Direct3DDevice9Ex_LSS<EnableSync>::ProcessVertices(UINT SrcStartIndex, U
   }
 
   auto* const pLssVtxDecl = bridge_cast<Direct3DVertexDeclaration9_LSS*>(pVertexDecl);
-  const UID vtxDeclId = (pLssVtxDecl) ? (UID) pLssVtxDecl->getId() : 0;
+  const UID vtxDeclId = (pLssVtxDecl) ? (UID) pLssVtxDecl->getServerId() : 0;
 
   auto* const pLssDestBuffer = bridge_cast<Direct3DVertexBuffer9_LSS*>(pDestBuffer);
   const UID destBufferId = (pLssDestBuffer) ? (UID) pLssDestBuffer->getId() : 0;
 
+  flushPendingBufferUpdates(false);
+  // The server writes the processed vertices into the destination buffer, so any of
+  // its held back updates must land first or they would overwrite the results later.
+  // The destination is usually not bound as a stream, so it is flushed separately.
+  if (m_bCoalesceNoOverwrite && pLssDestBuffer) {
+    BRIDGE_DEVICE_LOCKGUARD();
+    pLssDestBuffer->flushPendingRanges();
+  }
+
   // Send command to server and wait for response
   UID currentUID = 0;
   {
@@ -2433,25 +2485,50 @@ HRESULT Direct3DDevice9Ex_LSS<EnableSync>::CreateVertexDeclaration(CONST D3DVERT
   if (pVertexElements == nullptr || ppDecl == nullptr) {
     return D3DERR_INVALIDCALL;
   }
+  size_t numElem = 1; // We add one so we send the end marker as well
+  const auto pStart = pVertexElements;
+  const auto* pVtxElemItr = pVertexElements;
+  while (pVtxElemItr->Stream != 0xFF) {
+    numElem++;
+    pVtxElemItr++;
+  }
+
+  const bool bIntern = ClientOptions::getInternVertexDeclarations();
+  const size_t elementsSize = sizeof(D3DVERTEXELEMENT9) * numElem;
+
   UID currentUID = 0;
   {
-    auto* const pLssVtxDecl = trackWrapper(new Direct3DVertexDeclaration9_LSS(this, pVertexElements));
-    (*ppDecl) = pLssVtxDecl;
-
-    size_t numElem = 1; // We add one so we send the end marker as well
-    const auto pStart = pVertexElements;
-    const auto* pVtxElemItr = pVertexElements;
-    while (pVtxElemItr->Stream != 0xFF) {
-      numElem++;
-      pVtxElemItr++;
+    BRIDGE_DEVICE_LOCKGUARD();
+    Direct3DVertexDeclaration9_LSS* pLssVtxDecl = nullptr;
+    bool bCreate = true;
+    if (bIntern) {
+      // Every create returns a new declaration, but those made from a known element
+      // array share the server object of the first one
+      if (!m_pVertexDeclInterner) {
+        m_pVertexDeclInterner = std::make_shared<VertexDeclarationInterner>();
+      }
+      const uint64_t hash = bridge_util::MemoryHash::hash(pStart, elementsSize);
+      const size_t serverId = m_pVertexDeclInterner->acquire(hash, pStart, numElem, bCreate);
+      // On a hash collision the first element array stays interned
+      if (serverId != 0) {
+        pLssVtxDecl = new Direct3DVertexDeclaration9_LSS(this, pVertexElements, m_pVertexDeclInterner,
+                                                         hash, serverId);
+      }
+    }
+    if (pLssVtxDecl == nullptr) {
+      pLssVtxDecl = new Direct3DVertexDeclaration9_LSS(this, pVertexElements);
+    }
+    (*ppDecl) = trackWrapper(pLssVtxDecl);
+    if (!bCreate) {
+      return S_OK;
     }
 
     {
       ClientMessage c(Commands::IDirect3DDevice9Ex_CreateVertexDeclaration, getId());
       currentUID = c.get_uid();
       c.send_data(numElem);
-      c.send_data(sizeof(D3DVERTEXELEMENT9) * numElem, (void*) pStart);
-      c.send_data((uint32_t) pLssVtxDecl->getId());
+      c.send_data(elementsSize, (void*) pStart);
+      c.send_data((uint32_t) pLssVtxDecl->getServerId());
     }
   }
   WAIT_FOR_OPTIONAL_CREATE_FUNCTION_SERVER_RESPONSE("CreateVertexDeclaration()", D3DERR_INVALIDCALL, currentUID);
@@ -2463,7 +2540,7 @@ HRESULT Direct3DDevice9Ex_LSS<EnableSync>::SetVertexDeclaration(IDirect3DVertexD
   LogFunctionCall();
 
   auto* const pLssVtxDecl = bridge_cast<Direct3DVertexDeclaration9_LSS*>(pDecl);
-  const UID id = (pLssVtxDecl) ? (UID) pLssVtxDecl->getId() : 0;
+  const UID id = (pLssVtxDecl) ? (UID) pLssVtxDecl->getServerId() : 0;
   UID currentUID = 0;
   {
     {
@@ -2555,15 +2632,24 @@ HRESULT Direct3DDevice9Ex_LSS<EnableSync>::CreateVertexShader(CONST DWORD* pFunc
 
   uint32_t dataSize = 0;
   pLssVertexShader->GetFunction(nullptr, &dataSize);
+  const uint64_t hash = bridge_util::MemoryHash::hash(pFunction, dataSize);
 
   UID currentUID = 0;
   {
     ClientMessage c(Commands::IDirect3DDevice9Ex_CreateVertexShader, getId());
     currentUID = c.get_uid();
     c.send_data((uint32_t) pLssVertexShader->getId());
-    c.send_data(dataSize);
-    c.send_data(dataSize, (void*) pFunction);
-    
+    c.send_many((uint32_t) hash, (uint32_t) (hash >> 32));
+    // Bytecode the server has seen before is referenced by hash only. The set is
+    // updated while the command is being built to keep it in command order.
+    const bool bSendBytecode = !GlobalOptions::getEnableShaderCache() ||
+                               m_knownVertexShaderHashes.insert(hash).second;
+    if (bSendBytecode) {
+      c.send_data(dataSize);
+      c.send_data(dataSize, (void*) pFunction);
+    } else {
+      c.send_data(0);
+    }
   }
   WAIT_FOR_OPTIONAL_CREATE_FUNCTION_SERVER_RESPONSE("CreateVertexShader()", D3DERR_INVALIDCALL, currentUID);
 }
@@ -2948,14 +3034,23 @@ HRESULT Direct3DDevice9Ex_LSS<EnableSync>::CreatePixelShader(CONST DWORD* pFunct
 
   uint32_t dataSize = 0;
   pLssPixelShader->GetFunction(nullptr, &dataSize);
+  const uint64_t hash = bridge_util::MemoryHash::hash(pFunction, dataSize);
 
   UID currentUID = 0;
   {
     ClientMessage c(Commands::IDirect3DDevice9Ex_CreatePixelShader, getId());
     currentUID = c.get_uid();
     c.send_data((uint32_t) pLssPixelShader->getId());
-    c.send_data(dataSize);
-    c.send_data(dataSize, (void*) pFunction);
+    c.send_many((uint32_t) hash, (uint32_t) (hash >> 32));
+    // Same as in CreateVertexShader()
+    const bool bSendBytecode = !GlobalOptions::getEnableShaderCache() ||
+                               m_knownPixelShaderHashes.insert(hash).second;
+    if (bSendBytecode) {
+      c.send_data(dataSize);
+      c.send_data(dataSize, (void*) pFunction);
+    } else {
+      c.send_data(0);
+    }
   }
   WAIT_FOR_OPTIONAL_CREATE_FUNCTION_SERVER_RESPONSE("CreatePixelShader()", D3DERR_INVALIDCALL, currentUID);
 }
@@ -3162,7 +3257,7 @@ HRESULT Direct3DDevice9Ex_LSS<EnableSync>::CreateQuery(D3DQUERYTYPE Type, IDirec
   {
     ClientMessage c(Commands::IDirect3DDevice9Ex_CreateQuery, getId());
     currentUID = c.get_uid();
-    c.send_many(Type, (uint32_t) pLssQuery->getId());
+    c.send_many(Type, (uint32_t) pLssQuery->getId(), pLssQuery->getResultSlot());
   }
   return S_OK;
 }
@@ -3458,6 +3553,9 @@ HRESULT Direct3DDevice9Ex_LSS<EnableSync>::ResetEx(D3DPRESENT_PARAMETERS* pPrese
       DeviceBridge::pop_front();
     }
 
+    // The reset may have switched the display mode
+    ModuleQueryCache::invalidateDisplayModes("device reset");
+
     // Reset swapchain and link server backbuffer/depth buffer after the server reset its swapchain, or we will link to the old backbuffer/depth resources
     initImplicitObjects(presParam);
     // Keeping a track of previous present parameters, to detect and handle mode changes
@@ -3525,24 +3623,20 @@ HRESULT BaseDirect3DDevice9Ex_LSS::setShaderConstants(const uint32_t startRegist
       const size_t size = adjCount * sizeof(Vec4f);
       std::memcpy(set.fConsts[startRegister].data, pConstantData, size);
       if (m_stateRecording) {
-        for (int i = 0; i < adjCount; i++) {
-          if (ShaderT == ShaderType::Vertex) {
-            m_stateRecording->m_dirtyFlags.vertexConstants.fConsts[startRegister + i] = true;
-          } else {
-            m_stateRecording->m_dirtyFlags.pixelConstants.fConsts[startRegister + i] = true;
-          }
+        if (ShaderT == ShaderType::Vertex) {
+          m_stateRecording->m_dirtyFlags.vertexConstants.fConsts.setRange(startRegister, adjCount);
+        } else {
+          m_stateRecording->m_dirtyFlags.pixelConstants.fConsts.setRange(startRegister, adjCount);
         }
       }
     } else if constexpr (ConstantT == ConstantType::Int) {
       const size_t size = adjCount * sizeof(Vec4i);
       std::memcpy(set.iConsts[startRegister].data, pConstantData, size);
       if (m_stateRecording) {
-        for (int i = 0; i < adjCount; i++) {
-          if (ShaderT == ShaderType::Vertex) {
-            m_stateRecording->m_dirtyFlags.vertexConstants.iConsts[startRegister + i] = true;
-          } else {
-            m_stateRecording->m_dirtyFlags.pixelConstants.iConsts[startRegister + i] = true;
-          }
+        if (ShaderT == ShaderType::Vertex) {
+          m_stateRecording->m_dirtyFlags.vertexConstants.iConsts.setRange(startRegister, adjCount);
+        } else {
+          m_stateRecording->m_dirtyFlags.pixelConstants.iConsts.setRange(startRegister, adjCount);
         }
       }
     } else {
@@ -3556,12 +3650,12 @@ HRESULT BaseDirect3DDevice9Ex_LSS::setShaderConstants(const uint32_t startRegist
         if (pConstantData[i]) {
           set.bConsts[arrayIdx] |= bit;
         }
-        if (m_stateRecording) {
-          if (ShaderT == ShaderType::Vertex) {
-            m_stateRecording->m_dirtyFlags.vertexConstants.bConsts[startRegister + i] = true;
-          } else {
-            m_stateRecording->m_dirtyFlags.pixelConstants.bConsts[startRegister + i] = true;
-          }
+      }
+      if (m_stateRecording) {
+        if (ShaderT == ShaderType::Vertex) {
+          m_stateRecording->m_dirtyFlags.vertexConstants.bConsts.setRange(startRegister, adjCount);
+        } else {
+          m_stateRecording->m_dirtyFlags.pixelConstants.bConsts.setRange(startRegister, adjCount);
         }
       }
     }
@@ -22,11 +22,17 @@
 #pragma once
 
 #include "d3d9_device_base.h"
+#include "client_options.h"
 
 #include "util_common.h"
 #include "util_scopedlock.h"
 
+#include <memory>
 #include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+
+class VertexDeclarationInterner;
 
 template<bool EnableSync>
 class Direct3DDevice9Ex_LSS: public BaseDirect3DDevice9Ex_LSS {
@@ -229,6 +235,17 @@ public:
 private:
   bool m_bIsDestroying = false;
 
+  // Dynamic buffers only hold back updates when NOOVERWRITE coalescing is on
+  const bool m_bCoalesceNoOverwrite = ClientOptions::getCoalesceNoOverwriteLocks() &&
+                                      !ClientOptions::getOptimizedDynamicLock();
+
+  // Hashes of shader bytecode already sent to the server
+  std::unordered_set<uint64_t> m_knownVertexShaderHashes;
+  std::unordered_set<uint64_t> m_knownPixelShaderHashes;
+
+  // Shares server objects between vertex declarations with identical elements
+  std::shared_ptr<VertexDeclarationInterner> m_pVertexDeclInterner;
+
   D3DCAPS9 m_caps;
   HRESULT internalGetDeviceCaps(D3DCAPS9* pCaps);
 
@@ -240,5 +257,7 @@ private:
   template<typename T>
   HRESULT UpdateTextureImpl(IDirect3DBaseTexture9* pSourceTexture, IDirect3DBaseTexture9* pDestinationTexture);
   void setupFPU();
+  // Sends any held back dynamic buffer updates of the currently bound buffers
+  void flushPendingBufferUpdates(const bool bIndexed);
 };
 
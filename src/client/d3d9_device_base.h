@@ -27,6 +27,7 @@
 #include "d3d9.h"
 #include "base.h"
 #include "shadow_map.h"
+#include "util_bitset.h"
 
 #include <array>
 
@@ -198,15 +199,15 @@ protected:
     // Indices
     bool indices;
     // Render State
-    std::array<bool, kNumRenderStates> renderStates = { false };
+    bridge_util::BitSet<kNumRenderStates> renderStates;
     // Sampler States
-    std::array<std::array<bool, kMaxStageSamplerStateTypes>, kNumStageSamplers> samplerStates;
+    std::array<bridge_util::BitSet<kMaxStageSamplerStateTypes>, kNumStageSamplers> samplerStates;
     // Streams
-    std::array<bool, caps::MaxStreams> streams;
-    std::array<bool, caps::MaxStreams> streamOffsetsAndStrides;
-    std::array<bool, caps::MaxStreams> streamFreqs;
+    bridge_util::BitSet<caps::MaxStreams> streams;
+    bridge_util::BitSet<caps::MaxStreams> streamOffsetsAndStrides;
+    bridge_util::BitSet<caps::MaxStreams> streamFreqs;
     // Textures
-    std::array<bool, kNumStageSamplers> textures;
+    bridge_util::BitSet<kNumStageSamplers> textures;
     // Vertex Shader
     bool vertexShader;
     // Pixel Shader
@@ -218,25 +219,25 @@ protected:
     // Light Enables
     std::unordered_map<DWORD, bool> bLightEnables;
     // Transforms
-    std::array<bool, caps::MaxTransforms> transforms;
+    bridge_util::BitSet<caps::MaxTransforms> transforms;
     // Texture Stage State
-    using TextureStateArray = std::array<bool, kMaxTexStageStateTypes>;
+    using TextureStateArray = bridge_util::BitSet<kMaxTexStageStateTypes>;
     std::array<TextureStateArray, kNumStageSamplers> textureStageStates;
     // Viewport
     bool viewport;
     // Scissor Rect
     bool scissorRect;
-    std::array<bool, caps::MaxClipPlanes> clipPlanes;
+    bridge_util::BitSet<caps::MaxClipPlanes> clipPlanes;
     // Pixel Shader Constants
     struct VertexConstants {
-      std::array<bool, caps::MaxFloatConstantsSoftware> fConsts;
-      std::array<bool, caps::MaxOtherConstantsSoftware> iConsts;
-      std::array<bool, caps::MaxOtherConstantsSoftware> bConsts;
+      bridge_util::BitSet<caps::MaxFloatConstantsSoftware> fConsts;
+      bridge_util::BitSet<caps::MaxOtherConstantsSoftware> iConsts;
+      bridge_util::BitSet<caps::MaxOtherConstantsSoftware> bConsts;
     } vertexConstants;
     struct PixelConstants {
-      std::array<bool, caps::MaxFloatConstantsPS> fConsts;
-      std::array<bool, caps::MaxOtherConstants> iConsts;
-      std::array<bool, caps::MaxOtherConstants> bConsts;
+      bridge_util::BitSet<caps::MaxFloatConstantsPS> fConsts;
+      bridge_util::BitSet<caps::MaxOtherConstants> iConsts;
+      bridge_util::BitSet<caps::MaxOtherConstants> bConsts;
     } pixelConstants;
   };
 
@@ -37,10 +37,16 @@
 #include "remix_state.h"
 #include "window.h"
 #include "message_channels.h"
+#include "module_query_cache.h"
 
+#include "util_apitrace.h"
 #include "util_bridge_assert.h"
 #include "util_bridge_state.h"
 #include "util_common.h"
+#include "util_handletable.h"
+#include "util_inputring.h"
+#include "util_queryresults.h"
+#include "util_metrics.h"
 #include "util_devicecommand.h"
 #include "util_modulecommand.h"
 #include "util_filesys.h"
@@ -53,13 +59,37 @@
 #include <sstream>
 #include <stdio.h>
 #include <string>
+#include <atomic>
 #include <mutex>
+#include <thread>
+#include <chrono>
 
 using namespace bridge_util;
 
-std::atomic<uintptr_t> D3dBaseIdFactory::id_counter = 1;
+std::mutex D3dBaseIdFactory::s_mutex;
+std::vector<uint16_t> D3dBaseIdFactory::s_generations;
+std::deque<uint32_t> D3dBaseIdFactory::s_freeIndices;
+
 uintptr_t D3dBaseIdFactory::getNextId() {
-  return id_counter++;
+  std::scoped_lock lock(s_mutex);
+  uint32_t index;
+  if (s_freeIndices.size() > kMinFreeIndices) {
+    index = s_freeIndices.front();
+    s_freeIndices.pop_front();
+  } else {
+    assert(s_generations.size() < Handle::kMaxIndices && "Out of object handles");
+    index = (uint32_t) s_generations.size();
+    s_generations.push_back(0);
+  }
+  // Generation 0 is skipped so that a handle is never 0
+  uint16_t& generation = s_generations[index];
+  generation = (generation % Handle::kGenerationMask) + 1;
+  return Handle::make(index, generation);
+}
+
+void D3dBaseIdFactory::releaseId(const uintptr_t id) {
+  std::scoped_lock lock(s_mutex);
+  s_freeIndices.push_back(Handle::index((uint32_t) id));
 }
 
 #if defined(_DEBUG) || defined(DEBUGOPT)
@@ -114,8 +144,13 @@ Guid gUniqueIdentifier;
 Process* gpServer = nullptr;
 NamedSemaphore* gpPresent = nullptr;
 ShadowMap gShadowMap;
-std::mutex gShadowMapMutex;
-std::mutex serverStartMutex;
+std::timed_mutex serverStartMutex;
+bool gbServerWaitLogged = false;
+// Set once RemixDetach() started, so a pending background launch backs off
+std::atomic<bool> gbDetaching = false;
+// How long RemixDetach() waits for a background launch when timeouts are disabled
+static constexpr uint32_t kDetachLaunchWaitMs = 10000;
+std::chrono::steady_clock::time_point gTimeAttach;
 SceneState gSceneState = WaitBeginScene;
 std::chrono::steady_clock::time_point gTimeStart;
 bool gbBridgeRunning = true;
@@ -161,13 +196,12 @@ void OnServerExited(Process const* process) {
     std::chrono::duration_cast<std::chrono::seconds>(timeServerEnd - gTimeStart).count();
   uptimeSS << "s";
   Logger::info(uptimeSS.str());
+  Logger::info(format_string("[ShadowMap] Contended updates: %zu", gShadowMap.getContentionCount()));
 }
 
-void InitServer() {
-  std::lock_guard<std::mutex> guard(serverStartMutex);
-  if (gpServer != nullptr) {
-    return;
-  }
+// Launches the server and performs the handshake, serverStartMutex must be held
+static void LaunchServer() {
+  const auto launchStart = std::chrono::steady_clock::now();
   Logger::info("Launching server with GUID " + gUniqueIdentifier.toString());
   std::stringstream cmdSS;
   cmdSS << gRemixFolder;
@@ -254,6 +288,62 @@ void InitServer() {
   if (GlobalOptions::getUseSharedHeap()) {
     SharedHeap::init();
   }
+
+  Logger::info(format_string("[Startup] Server launch and handshake took %lld ms.",
+    std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - launchStart).count()));
+}
+
+// Ensures the server is up, either by launching it or by waiting for the
+// eager launch on the background thread to finish
+void InitServer() {
+  const auto waitStart = std::chrono::steady_clock::now();
+  std::lock_guard<std::timed_mutex> guard(serverStartMutex);
+  if (gpServer == nullptr) {
+    LaunchServer();
+  } else if (!gbServerWaitLogged) {
+    gbServerWaitLogged = true;
+    Logger::info(format_string("[Startup] Waited %lld ms for the background server launch to complete.",
+      std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - waitStart).count()));
+  }
+}
+
+static DWORD WINAPI EagerServerLaunchThread(LPVOID pModule) {
+  {
+    std::lock_guard<std::timed_mutex> guard(serverStartMutex);
+    if (gpServer == nullptr && !gbDetaching) {
+      Logger::info("[Startup] Launching server in the background.");
+      LaunchServer();
+    }
+  }
+  FreeLibraryAndExitThread(static_cast<HMODULE>(pModule), 0);
+}
+
+// Starts launching the server on a background thread so that its startup
+// overlaps with the game's own initialization. Runs from DllMain, so the
+// thread only starts once the loader lock is released and cannot be joined.
+// Instead the thread holds a reference on this module until it exits, so
+// the client can't be unloaded and detached while the launch is in flight.
+static void LaunchServerEagerly() {
+  HMODULE hSelf = NULL;
+  if (!GetModuleHandleEx(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS,
+                         reinterpret_cast<LPCTSTR>(&EagerServerLaunchThread), &hSelf)) {
+    Logger::warn("[Startup] Unable to pin the client module, launching the server on first use.");
+    return;
+  }
+  const HANDLE hThread = CreateThread(nullptr, 0, EagerServerLaunchThread, hSelf, 0, nullptr);
+  if (hThread == NULL) {
+    FreeLibrary(hSelf);
+    return;
+  }
+  CloseHandle(hThread);
+}
+
+void LogTimeToFirstFrame() {
+  static std::once_flag once;
+  std::call_once(once, []() {
+    Logger::info(format_string("[Startup] Time to first frame: %lld ms after client attach.",
+      std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - gTimeAttach).count()));
+  });
 }
 
 bool InitRemixFolder(HMODULE hinst) {
@@ -356,6 +446,8 @@ extern "C" {
 
 bool RemixAttach(HMODULE hModule) {
   if (!gIsAttached) {
+    gTimeAttach = std::chrono::steady_clock::now();
+
     // Sort out module/library handles
     if(!hModule) {
       const DWORD getHandleFlags = GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT;
@@ -376,6 +468,7 @@ bool RemixAttach(HMODULE hModule) {
 
     // Initialize logger
     Logger::init();
+    ApiTrace::init();
 
     // Setup Remix folder first hand
     if (!InitRemixFolder(hModule)) {
@@ -403,6 +496,9 @@ bool RemixAttach(HMODULE hModule) {
 
     initModuleBridge();
     initDeviceBridge();
+    Metrics::init();
+    InputRing::init();
+    QueryResults::init();
 
     gpPresent = new NamedSemaphore("Present", 0, GlobalOptions::getPresentSemaphoreMaxFrames());
 
@@ -422,6 +518,10 @@ bool RemixAttach(HMODULE hModule) {
     atexit(RemixDetach);
 #endif
 
+    if (ClientOptions::getEagerServerLaunch()) {
+      LaunchServerEagerly();
+    }
+
     gIsAttached = true;
   }
 
@@ -434,7 +534,17 @@ void RemixDetach() {
     BridgeState::setClientState(BridgeState::ProcessState::DoneProcessing);
     Logger::info("About to unload bridge client.");
 
-    if (gpServer) {
+    // The background launch owns gpServer and the channels while it holds the
+    // mutex. At process exit the OS may have killed that thread with the mutex
+    // still held, so only wait for it a bounded amount of time. A command timeout
+    // of 0 means timeouts are disabled, fall back to a fixed wait then.
+    gbDetaching = true;
+    const uint32_t commandTimeout = GlobalOptions::getCommandTimeout();
+    const uint32_t launchWaitMs = (commandTimeout > 0) ? commandTimeout : kDetachLaunchWaitMs;
+    std::unique_lock<std::timed_mutex> serverGuard(serverStartMutex, std::defer_lock);
+    if (!serverGuard.try_lock_for(std::chrono::milliseconds(launchWaitMs))) {
+      Logger::err("Server launch did not complete, skipping server shutdown.");
+    } else if (gpServer) {
       // Instruct the server to wrap things up and bail
       // Note that while we can queue up the command the semaphore doesn't work anymore at this point
       Logger::info("Sending Terminate command to server...");
@@ -454,9 +564,11 @@ void RemixDetach() {
       }
 
       delete gpServer;
+      gpServer = nullptr;
     }
 
     PrintRecentCommandHistory();
+    ModuleQueryCache::save();
 
     // Clean up resources
     delete gpPresent;
@@ -69,12 +69,8 @@ IDirect3D9* LssDirect3DCreate9(UINT SDKVersion);
 class Direct3D9Ex_LSS: public D3DBase<IDirect3D9Ex> {
   const bool m_ex;
   UINT m_adapterCount = 0;
-  std::unordered_map<size_t, D3DADAPTER_IDENTIFIER9> m_adapterIdentifiers;
-  std::unordered_map<size_t, UINT> m_adapterModeCount;
-  std::unordered_map<size_t, D3DDISPLAYMODE> m_enumAdapterMode;
-  std::unordered_map<size_t, D3DCAPS9> m_deviceCaps;
-  std::unordered_map<UINT, D3DDISPLAYMODE> m_adapterDisplayMode;
   void onDestroy() override;
+  void validateQueryCache(UINT Adapter);
 
 public:
   Direct3D9Ex_LSS(IDirect3D9Ex* const pDevice)
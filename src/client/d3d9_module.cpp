@@ -23,6 +23,7 @@
 
 #include "d3d9_device.h"
 #include "d3d9_swapchain.h"
+#include "module_query_cache.h"
 #include "remix_state.h"
 
 #include "util_bridge_assert.h"
@@ -38,18 +39,6 @@
     } \
   }
 
-// This is a modified version of the original hash_combine function
-// from Boost. See: https://github.com/boostorg/container_hash
-template <typename T, typename... Rest>
-void hash_combine(std::size_t& seed, const T& v, const Rest&... rest) {
-  seed ^= std::hash<T>{}(v) +0x9e3779b9 + (seed << 6) + (seed >> 2);
-  (hash_combine(seed, rest), ...);
-}
-
-#define GET_HASH(hashname, ...) \
-  size_t hashname = 0; \
-  hash_combine(hashname, __VA_ARGS__);
-
 HRESULT Direct3D9Ex_LSS::QueryInterface(REFIID riid, LPVOID* ppvObj) {
   LogFunctionCall();
   if (ppvObj == nullptr) {
@@ -93,6 +82,16 @@ void Direct3D9Ex_LSS::onDestroy() {
 
   // Make sure server consumed IDirect3D9Ex_Destroy
   ModuleBridge::ensureQueueEmpty();
+
+  ModuleQueryCache::save();
+}
+
+void Direct3D9Ex_LSS::validateQueryCache(UINT Adapter) {
+  // Fetching the live identifier validates the persisted results for the adapter
+  if (ModuleQueryCache::needsValidation(Adapter)) {
+    D3DADAPTER_IDENTIFIER9 identifier;
+    GetAdapterIdentifier(Adapter, 0, &identifier);
+  }
 }
 
 HRESULT Direct3D9Ex_LSS::RegisterSoftwareDevice(void* pInitializeFunction) {
@@ -133,10 +132,10 @@ HRESULT Direct3D9Ex_LSS::GetAdapterIdentifier(UINT Adapter, DWORD Flags, D3DADAP
     return D3DERR_INVALIDCALL;
   }
 
-  GET_HASH(key, Adapter, Flags);
-  if (m_adapterIdentifiers.find(key) != m_adapterIdentifiers.end()) {
-    *pIdentifier = m_adapterIdentifiers[key];
-    return S_OK;
+  HRESULT hresult = S_OK;
+  const auto key = ModuleQueryCache::makeKey(Commands::IDirect3D9Ex_GetAdapterIdentifier, Adapter, Flags);
+  if (ModuleQueryCache::find(key, hresult, *pIdentifier)) {
+    return hresult;
   }
 
   UID currentUID = 0;
@@ -148,14 +147,19 @@ HRESULT Direct3D9Ex_LSS::GetAdapterIdentifier(UINT Adapter, DWORD Flags, D3DADAP
   }
   WAIT_FOR_SERVER_RESPONSE("GetAdapterIdentifier()", E_FAIL, currentUID);
 
-  HRESULT hresult = ModuleBridge::get_data();
+  hresult = ModuleBridge::get_data();
   if (SUCCEEDED(hresult)) {
-    D3DADAPTER_IDENTIFIER9& adapterIdentifier = m_adapterIdentifiers[key];
+    D3DADAPTER_IDENTIFIER9 adapterIdentifier;
     uint32_t len = ModuleBridge::copy_data(adapterIdentifier, false);
     // The structs are essentially the same, but the x64 side adds 4 extra bytes for padding
     if (len != (sizeof(D3DADAPTER_IDENTIFIER9) + 4) && len != 0) {
       Logger::err("GetAdapterIdentifier() failed due to issue with data returned from server.");
       hresult = D3DERR_INVALIDCALL;
+    } else {
+      ModuleQueryCache::store(key, hresult, adapterIdentifier);
+      if (Flags == 0) {
+        ModuleQueryCache::validateAdapter(Adapter, adapterIdentifier);
+      }
     }
     *pIdentifier = adapterIdentifier;
   }
@@ -171,9 +175,11 @@ UINT Direct3D9Ex_LSS::GetAdapterModeCount(UINT Adapter, D3DFORMAT Format) {
     return 0;
   }
 
-  GET_HASH(key, Adapter, Format);
-  if (m_adapterModeCount.find(key) != m_adapterModeCount.end()) {
-    return m_adapterModeCount[key];
+  HRESULT hresult = S_OK;
+  UINT cnt = 0;
+  const auto key = ModuleQueryCache::makeKey(Commands::IDirect3D9Ex_GetAdapterModeCount, Adapter, Format);
+  if (ModuleQueryCache::find(key, hresult, cnt)) {
+    return cnt;
   }
 
   UID currentUID = 0;
@@ -185,9 +191,10 @@ UINT Direct3D9Ex_LSS::GetAdapterModeCount(UINT Adapter, D3DFORMAT Format) {
   }
   WAIT_FOR_SERVER_RESPONSE("GetAdapterModeCount()", 0, currentUID);
 
-  m_adapterModeCount[key] = (UINT) ModuleBridge::get_data();
+  cnt = (UINT) ModuleBridge::get_data();
   ModuleBridge::pop_front();
-  return m_adapterModeCount[key];
+  ModuleQueryCache::store(key, S_OK, cnt);
+  return cnt;
 }
 
 HRESULT Direct3D9Ex_LSS::EnumAdapterModes(UINT Adapter, D3DFORMAT Format, UINT Mode, D3DDISPLAYMODE* pMode) {
@@ -198,10 +205,10 @@ HRESULT Direct3D9Ex_LSS::EnumAdapterModes(UINT Adapter, D3DFORMAT Format, UINT M
     return  D3DERR_INVALIDCALL;
   }
 
-  GET_HASH(key, Adapter, Format, Mode);
-  if (m_enumAdapterMode.find(key) != m_enumAdapterMode.end()) {
-    *pMode = m_enumAdapterMode[key];
-    return S_OK;
+  HRESULT hresult = S_OK;
+  const auto key = ModuleQueryCache::makeKey(Commands::IDirect3D9Ex_EnumAdapterModes, Adapter, Format, Mode);
+  if (ModuleQueryCache::find(key, hresult, *pMode)) {
+    return hresult;
   }
 
   UID currentUID = 0;
@@ -213,13 +220,15 @@ HRESULT Direct3D9Ex_LSS::EnumAdapterModes(UINT Adapter, D3DFORMAT Format, UINT M
   }
   WAIT_FOR_SERVER_RESPONSE("EnumAdapterModes()", D3DERR_INVALIDCALL, currentUID);
 
-  HRESULT hresult = ModuleBridge::get_data();
+  hresult = ModuleBridge::get_data();
   if (SUCCEEDED(hresult)) {
-    D3DDISPLAYMODE& adapterMode = m_enumAdapterMode[key];
+    D3DDISPLAYMODE adapterMode;
     uint32_t len = ModuleBridge::copy_data(adapterMode);
     if (len != sizeof(D3DDISPLAYMODE) && len != 0) {
       Logger::err("EnumAdapterModes() failed due to issue with data returned from server.");
       hresult = D3DERR_INVALIDCALL;
+    } else {
+      ModuleQueryCache::store(key, hresult, adapterMode);
     }
     *pMode = adapterMode;
   }
@@ -235,9 +244,10 @@ HRESULT Direct3D9Ex_LSS::GetAdapterDisplayMode(UINT Adapter, D3DDISPLAYMODE* pMo
     return  D3DERR_INVALIDCALL;
   }
 
-  if (m_adapterDisplayMode.find(Adapter) != m_adapterDisplayMode.end()) {
-    *pMode = m_adapterDisplayMode[Adapter];
-    return S_OK;
+  HRESULT hresult = S_OK;
+  const auto key = ModuleQueryCache::makeKey(Commands::IDirect3D9Ex_GetAdapterDisplayMode, Adapter);
+  if (ModuleQueryCache::find(key, hresult, *pMode)) {
+    return hresult;
   }
 
   UID currentUID = 0;
@@ -249,13 +259,15 @@ HRESULT Direct3D9Ex_LSS::GetAdapterDisplayMode(UINT Adapter, D3DDISPLAYMODE* pMo
   }
   WAIT_FOR_SERVER_RESPONSE("GetAdapterDisplayMode()", D3DERR_INVALIDCALL, currentUID);
 
-  HRESULT hresult = ModuleBridge::get_data();
+  hresult = ModuleBridge::get_data();
   if (SUCCEEDED(hresult)) {
-    D3DDISPLAYMODE& displayMode = m_adapterDisplayMode[Adapter];
+    D3DDISPLAYMODE displayMode;
     uint32_t len = ModuleBridge::copy_data(displayMode);
     if (len != sizeof(D3DDISPLAYMODE) && len != 0) {
       Logger::err("GetAdapterDisplayMode() failed due to issue with data returned from server.");
       hresult =  D3DERR_INVALIDCALL;
+    } else {
+      ModuleQueryCache::store(key, hresult, displayMode);
     }
     *pMode = displayMode;
   }
@@ -271,6 +283,13 @@ HRESULT Direct3D9Ex_LSS::CheckDeviceType(UINT Adapter, D3DDEVTYPE CheckType, D3D
     return  D3DERR_INVALIDCALL;
   }
 
+  validateQueryCache(Adapter);
+  HRESULT res = S_OK;
+  const auto key = ModuleQueryCache::makeKey(Commands::IDirect3D9Ex_CheckDeviceType, Adapter, CheckType, DisplayFormat, BackBufferFormat, Windowed);
+  if (ModuleQueryCache::find(key, res)) {
+    return res;
+  }
+
   UID currentUID = 0;
   // Send command to server and wait for response
   {
@@ -280,8 +299,9 @@ HRESULT Direct3D9Ex_LSS::CheckDeviceType(UINT Adapter, D3DDEVTYPE CheckType, D3D
   }
   WAIT_FOR_SERVER_RESPONSE("CheckDeviceType()", E_FAIL, currentUID);
 
-  HRESULT res = (HRESULT) ModuleBridge::get_data();
+  res = (HRESULT) ModuleBridge::get_data();
   ModuleBridge::pop_front();
+  ModuleQueryCache::store(key, res);
   return res;
 }
 
@@ -293,6 +313,13 @@ HRESULT Direct3D9Ex_LSS::CheckDeviceFormat(UINT Adapter, D3DDEVTYPE DeviceType,
     return  D3DERR_INVALIDCALL;
   }
 
+  validateQueryCache(Adapter);
+  HRESULT res = S_OK;
+  const auto key = ModuleQueryCache::makeKey(Commands::IDirect3D9Ex_CheckDeviceFormat, Adapter, DeviceType, AdapterFormat, Usage, RType, CheckFormat);
+  if (ModuleQueryCache::find(key, res)) {
+    return res;
+  }
+
   UID currentUID = 0;
   // Send command to server and wait for response
   {
@@ -302,8 +329,9 @@ HRESULT Direct3D9Ex_LSS::CheckDeviceFormat(UINT Adapter, D3DDEVTYPE DeviceType,
   }
   WAIT_FOR_SERVER_RESPONSE("CheckDeviceFormat()", D3DERR_NOTAVAILABLE, currentUID);
 
-  HRESULT res = (HRESULT) ModuleBridge::get_data();
+  res = (HRESULT) ModuleBridge::get_data();
   ModuleBridge::pop_front();
+  ModuleQueryCache::store(key, res);
   return res;
 }
 
@@ -319,22 +347,29 @@ HRESULT Direct3D9Ex_LSS::CheckDeviceMultiSampleType(UINT Adapter, D3DDEVTYPE Dev
     return  D3DERR_INVALIDCALL;
   }
 
-  UID currentUID = 0;
-  // Send command to server and wait for response
-  {
-    ModuleClientCommand c(Commands::IDirect3D9Ex_CheckDeviceMultiSampleType);
-    currentUID = c.get_uid();
-    c.send_many(Adapter, DeviceType, SurfaceFormat, Windowed, MultiSampleType);
-  }
-  WAIT_FOR_SERVER_RESPONSE("CheckDeviceMultiSampleType()", E_FAIL, currentUID);
+  validateQueryCache(Adapter);
+  HRESULT res = S_OK;
+  DWORD QualityLevelsLocal = 0;
+  const auto key = ModuleQueryCache::makeKey(Commands::IDirect3D9Ex_CheckDeviceMultiSampleType, Adapter, DeviceType, SurfaceFormat, Windowed, MultiSampleType);
+  if (!ModuleQueryCache::find(key, res, QualityLevelsLocal)) {
+    UID currentUID = 0;
+    // Send command to server and wait for response
+    {
+      ModuleClientCommand c(Commands::IDirect3D9Ex_CheckDeviceMultiSampleType);
+      currentUID = c.get_uid();
+      c.send_many(Adapter, DeviceType, SurfaceFormat, Windowed, MultiSampleType);
+    }
+    WAIT_FOR_SERVER_RESPONSE("CheckDeviceMultiSampleType()", E_FAIL, currentUID);
 
-  HRESULT res = (HRESULT) ModuleBridge::get_data();
-  DWORD QualityLevelsLocal = (DWORD) ModuleBridge::get_data();
+    res = (HRESULT) ModuleBridge::get_data();
+    QualityLevelsLocal = (DWORD) ModuleBridge::get_data();
+    ModuleBridge::pop_front();
+    ModuleQueryCache::store(key, res, QualityLevelsLocal);
+  }
 
   if (pQualityLevels != NULL) {
     *pQualityLevels = QualityLevelsLocal;
   }
-  ModuleBridge::pop_front();
 
   return res;
 }
@@ -347,6 +382,13 @@ HRESULT Direct3D9Ex_LSS::CheckDepthStencilMatch(UINT Adapter, D3DDEVTYPE DeviceT
     return  D3DERR_INVALIDCALL;
   }
 
+  validateQueryCache(Adapter);
+  HRESULT res = S_OK;
+  const auto key = ModuleQueryCache::makeKey(Commands::IDirect3D9Ex_CheckDepthStencilMatch, Adapter, DeviceType, AdapterFormat, RenderTargetFormat, DepthStencilFormat);
+  if (ModuleQueryCache::find(key, res)) {
+    return res;
+  }
+
   UID currentUID = 0;
   // Send command to server and wait for response
   {
@@ -356,8 +398,9 @@ HRESULT Direct3D9Ex_LSS::CheckDepthStencilMatch(UINT Adapter, D3DDEVTYPE DeviceT
   }
   WAIT_FOR_SERVER_RESPONSE("CheckDepthStencilMatch()", E_FAIL, currentUID);
 
-  HRESULT res = (HRESULT) ModuleBridge::get_data();
+  res = (HRESULT) ModuleBridge::get_data();
   ModuleBridge::pop_front();
+  ModuleQueryCache::store(key, res);
   return res;
 }
 
@@ -369,6 +412,13 @@ HRESULT Direct3D9Ex_LSS::CheckDeviceFormatConversion(UINT Adapter, D3DDEVTYPE De
     return  D3DERR_INVALIDCALL;
   }
 
+  validateQueryCache(Adapter);
+  HRESULT res = S_OK;
+  const auto key = ModuleQueryCache::makeKey(Commands::IDirect3D9Ex_CheckDeviceFormatConversion, Adapter, DeviceType, SourceFormat, TargetFormat);
+  if (ModuleQueryCache::find(key, res)) {
+    return res;
+  }
+
   UID currentUID = 0;
   // Send command to server and wait for response
   {
@@ -378,8 +428,9 @@ HRESULT Direct3D9Ex_LSS::CheckDeviceFormatConversion(UINT Adapter, D3DDEVTYPE De
   }
   WAIT_FOR_SERVER_RESPONSE("CheckDeviceFormatConversion()", E_FAIL, currentUID);
 
-  HRESULT res = (HRESULT) ModuleBridge::get_data();
+  res = (HRESULT) ModuleBridge::get_data();
   ModuleBridge::pop_front();
+  ModuleQueryCache::store(key, res);
   return res;
 }
 
@@ -394,10 +445,11 @@ HRESULT Direct3D9Ex_LSS::GetDeviceCaps(UINT Adapter, D3DDEVTYPE DeviceType, D3DC
     return  D3DERR_INVALIDCALL;
   }
 
-  GET_HASH(key, Adapter, DeviceType);
-  if (m_deviceCaps.find(key) != m_deviceCaps.end()) {
-    *pCaps = m_deviceCaps[key];
-    return S_OK;
+  validateQueryCache(Adapter);
+  HRESULT hresult = S_OK;
+  const auto key = ModuleQueryCache::makeKey(Commands::IDirect3D9Ex_GetDeviceCaps, Adapter, DeviceType);
+  if (ModuleQueryCache::find(key, hresult, *pCaps)) {
+    return hresult;
   }
 
   UID currentUID = 0;
@@ -410,13 +462,15 @@ HRESULT Direct3D9Ex_LSS::GetDeviceCaps(UINT Adapter, D3DDEVTYPE DeviceType, D3DC
 
   WAIT_FOR_SERVER_RESPONSE("GetDeviceCaps()", D3DERR_INVALIDCALL, currentUID);
 
-  HRESULT hresult = ModuleBridge::get_data();
+  hresult = ModuleBridge::get_data();
   if (SUCCEEDED(hresult)) {
-    D3DCAPS9& deviceCaps = m_deviceCaps[key];
+    D3DCAPS9 deviceCaps;
     uint32_t len = ModuleBridge::copy_data(deviceCaps);
     if (len != sizeof(D3DCAPS9) && len != 0) {
       Logger::err("GetDeviceCaps() failed due to issue with data returned from server.");
       hresult = D3DERR_INVALIDCALL;
+    } else {
+      ModuleQueryCache::store(key, hresult, deviceCaps);
     }
     *pCaps = deviceCaps;
   }
@@ -466,6 +520,14 @@ UINT Direct3D9Ex_LSS::GetAdapterModeCountEx(UINT Adapter, CONST D3DDISPLAYMODEFI
   }
 
   UINT cnt = 0;
+  HRESULT hresult = S_OK;
+  const auto key = pFilter == nullptr ?
+    ModuleQueryCache::makeKey(Commands::IDirect3D9Ex_GetAdapterModeCountEx, Adapter) :
+    ModuleQueryCache::makeKey(Commands::IDirect3D9Ex_GetAdapterModeCountEx, Adapter, pFilter->Size, pFilter->Format, pFilter->ScanLineOrdering);
+  if (pFilter != nullptr && ModuleQueryCache::find(key, hresult, cnt)) {
+    return cnt;
+  }
+
   UID currentUID = 0;
   // Send command to server and wait for response
   {
@@ -478,6 +540,9 @@ UINT Direct3D9Ex_LSS::GetAdapterModeCountEx(UINT Adapter, CONST D3DDISPLAYMODEFI
 
   cnt = (UINT) ModuleBridge::get_data();
   ModuleBridge::pop_front();
+  if (pFilter != nullptr) {
+    ModuleQueryCache::store(key, S_OK, cnt);
+  }
   return cnt;
 }
 
@@ -494,6 +559,12 @@ HRESULT Direct3D9Ex_LSS::EnumAdapterModesEx(UINT Adapter, CONST D3DDISPLAYMODEFI
     return  D3DERR_INVALIDCALL;
   }
 
+  HRESULT hresult = S_OK;
+  const auto key = ModuleQueryCache::makeKey(Commands::IDirect3D9Ex_EnumAdapterModesEx, Adapter, Mode, pFilter->Size, pFilter->Format, pFilter->ScanLineOrdering);
+  if (ModuleQueryCache::find(key, hresult, *pMode)) {
+    return hresult;
+  }
+
   UID currentUID = 0;
   // Send command to server and wait for response
   {
@@ -505,12 +576,14 @@ HRESULT Direct3D9Ex_LSS::EnumAdapterModesEx(UINT Adapter, CONST D3DDISPLAYMODEFI
   }
   WAIT_FOR_SERVER_RESPONSE("EnumAdapterModesEx()", D3DERR_INVALIDCALL, currentUID);
 
-  HRESULT hresult = ModuleBridge::get_data();
+  hresult = ModuleBridge::get_data();
   if (SUCCEEDED(hresult)) {
     uint32_t len = ModuleBridge::copy_data(*pMode);
     if (len != sizeof(D3DDISPLAYMODEEX) && len != 0) {
       Logger::err("EnumAdapterModesEx() failed due to issue with data returned from server.");
       hresult = D3DERR_INVALIDCALL;
+    } else {
+      ModuleQueryCache::store(key, hresult, *pMode);
     }
   }
   ModuleBridge::pop_front();
@@ -652,5 +725,9 @@ std::tuple<HRESULT, BaseDirect3DDevice9Ex_LSS*> Direct3D9Ex_LSS::createDevice(
     pNewDevice = new Direct3DDevice9Ex_LSS<false>(
       bExtended, pDirect3D, createParams, localPresParam, pFullscreenDisplayMode, createDeviceHresult);
   }
+
+  if (localPresParam.Windowed == FALSE) {
+    ModuleQueryCache::invalidateDisplayModes("fullscreen device created");
+  }
   return { createDeviceHresult, pNewDevice };
 }
\ No newline at end of file
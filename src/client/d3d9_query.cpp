@@ -54,6 +54,9 @@ ULONG Direct3DQuery9_LSS::Release() {
 void Direct3DQuery9_LSS::onDestroy() {
   LogFunctionCall();
   ClientMessage { Commands::IDirect3DQuery9_Destroy, getId() };
+  // The server stops pushing to the slot once it processes the destroy, and
+  // results from this query never match the tag of the slot's next owner
+  QueryResults::releaseSlot(m_resultSlot);
 }
 
 HRESULT Direct3DQuery9_LSS::GetDevice(IDirect3DDevice9** ppDevice) {
@@ -93,6 +96,12 @@ HRESULT Direct3DQuery9_LSS::Issue(DWORD dwIssueFlags) {
   LogFunctionCall();
   
   UID currentUID = 0;
+
+  // Mirrors the server, which counts every END issue whether or not it succeeds
+  if (dwIssueFlags & D3DISSUE_END) {
+    ++m_generation;
+    m_numMisses = 0;
+  }
   
   {
     ClientMessage c(Commands::IDirect3DQuery9_Issue, getId());
@@ -107,6 +116,20 @@ HRESULT Direct3DQuery9_LSS::Issue(DWORD dwIssueFlags) {
 HRESULT Direct3DQuery9_LSS::GetData(void* pData, DWORD dwSize, DWORD dwGetDataFlags) {
   LogFunctionCall();
 
+  // Every so many misses fall back to a round trip, which also guarantees
+  // progress if the game spins on GetData without sending anything else
+  // the server would poll the query after
+  static constexpr uint32_t kRoundTripInterval = 16;
+  if (m_resultSlot != QueryResults::kNoSlot && m_generation > 0) {
+    int32_t hresult = S_FALSE;
+    if (QueryResults::read(m_resultSlot, getId(), m_generation, pData, dwSize, hresult)) {
+      return hresult;
+    }
+    if ((++m_numMisses % kRoundTripInterval) != 0) {
+      return S_FALSE;
+    }
+  }
+
   UID currentUID = 0;
   {
     ClientMessage c(Commands::IDirect3DQuery9_GetData, getId());
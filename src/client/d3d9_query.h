@@ -24,18 +24,34 @@
 #include "d3d9_util.h"
 #include "base.h"
 #include "d3d9_device_base.h"
+#include "client_options.h"
+#include "util_queryresults.h"
 
 class Direct3DQuery9_LSS: public D3DBase<IDirect3DQuery9> {
   void onDestroy() override;
   D3DQUERYTYPE m_type;
 
+  // Slot the server pushes this query's results into, see QueryResults
+  const uint32_t m_resultSlot;
+  // Number of D3DISSUE_END issues, identifies the result to wait for
+  uint32_t m_generation = 0;
+  // Local reads that found no result for the current issue
+  uint32_t m_numMisses = 0;
+
 protected:
   BaseDirect3DDevice9Ex_LSS* const m_pDevice = nullptr;
 public:
   Direct3DQuery9_LSS(BaseDirect3DDevice9Ex_LSS* const pDevice, D3DQUERYTYPE Type)
     : D3DBase<IDirect3DQuery9>((IDirect3DQuery9*) nullptr, pDevice)
     , m_pDevice(pDevice)
-    , m_type(Type) {
+    , m_type(Type)
+    , m_resultSlot(ClientOptions::getQueryResultPush() ?
+                   bridge_util::QueryResults::acquireSlot(Type) :
+                   bridge_util::QueryResults::kNoSlot) {
+  }
+
+  uint32_t getResultSlot() const {
+    return m_resultSlot;
   }
 
   /*** IUnknown methods ***/
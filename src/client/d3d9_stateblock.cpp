@@ -69,47 +69,47 @@ HRESULT Direct3DStateBlock9_LSS::GetDevice(IDirect3DDevice9** ppDevice) {
   return S_OK;
 }
 
-void Direct3DStateBlock9_LSS::StateTransfer(const BaseDirect3DDevice9Ex_LSS::StateCaptureDirtyFlags& flags, BaseDirect3DDevice9Ex_LSS::State& src, BaseDirect3DDevice9Ex_LSS::State& dst) {
-  for (size_t i = 0; i < dst.renderStates.size(); i++) {
-    if (flags.renderStates[i]) {
-      dst.renderStates[i] = src.renderStates[i];
+namespace {
+  // Copies the flagged bits of a packed boolean constant array
+  template<size_t N, size_t W>
+  void transferBoolConstants(const bridge_util::BitSet<N>& flags, const uint32_t(&src)[W], uint32_t(&dst)[W]) {
+    static_assert(bridge_util::BitSet<N>::kNumWords == W, "Flag and constant words must match");
+    for (size_t w = 0; w < W; w++) {
+      const uint32_t mask = flags.word(w);
+      dst[w] = (dst[w] & ~mask) | (src[w] & mask);
     }
   }
+}
+
+void Direct3DStateBlock9_LSS::StateTransfer(const BaseDirect3DDevice9Ex_LSS::StateCaptureDirtyFlags& flags, BaseDirect3DDevice9Ex_LSS::State& src, BaseDirect3DDevice9Ex_LSS::State& dst) {
+  flags.renderStates.forEachSet([&](const size_t i) {
+    dst.renderStates[i] = src.renderStates[i];
+  });
   if (flags.vertexDecl) {
     dst.vertexDecl = src.vertexDecl;
   }
   if (flags.indices) {
     dst.indices = src.indices;
   }
-  for (int i = 0; i < flags.samplerStates.size(); i++) {
-    for (int j = 0; j < flags.samplerStates[i].size(); j++) {
-      if (flags.samplerStates[i][j]) {
-        dst.samplerStates[i][j] = src.samplerStates[i][j];
-      }
-    }
-  }
-  for (int i = 0; i < flags.streams.size(); i++) {
-    if (flags.streams[i]) {
-      dst.streams[i] = src.streams[i];
-    }
-  }
-  for (int i = 0; i < flags.streamOffsetsAndStrides.size(); i++) {
-    if (flags.streamOffsetsAndStrides[i]) {
-      dst.streamOffsets[i] = src.streamOffsets[i];
-      dst.streamStrides[i] = src.streamStrides[i];
-    }
-  }
-  for (int i = 0; i < flags.streamFreqs.size(); i++) {
-    if (flags.streamFreqs[i]) {
-      dst.streamFreqs[i] = src.streamFreqs[i];
-    }
-  }
-  for (int i = 0; i < flags.textures.size(); i++) {
-    if (flags.textures[i]) {
-      dst.textures[i] = src.textures[i];
-      dst.textureTypes[i] = src.textureTypes[i];
-    }
-  }
+  for (size_t i = 0; i < flags.samplerStates.size(); i++) {
+    flags.samplerStates[i].forEachSet([&](const size_t j) {
+      dst.samplerStates[i][j] = src.samplerStates[i][j];
+    });
+  }
+  flags.streams.forEachSet([&](const size_t i) {
+    dst.streams[i] = src.streams[i];
+  });
+  flags.streamOffsetsAndStrides.forEachSet([&](const size_t i) {
+    dst.streamOffsets[i] = src.streamOffsets[i];
+    dst.streamStrides[i] = src.streamStrides[i];
+  });
+  flags.streamFreqs.forEachSet([&](const size_t i) {
+    dst.streamFreqs[i] = src.streamFreqs[i];
+  });
+  flags.textures.forEachSet([&](const size_t i) {
+    dst.textures[i] = src.textures[i];
+    dst.textureTypes[i] = src.textureTypes[i];
+  });
   if (flags.vertexShader) {
     dst.vertexShader = src.vertexShader;
   }
@@ -125,17 +125,13 @@ void Direct3DStateBlock9_LSS::StateTransfer(const BaseDirect3DDevice9Ex_LSS::Sta
   for (const auto& [key, value] : flags.bLightEnables) {
     dst.bLightEnables[key] = src.bLightEnables[key];
   }
-  for (int i = 0; i < flags.transforms.size(); i++) {
-    if (flags.transforms[i]) {
-      dst.transforms[i] = src.transforms[i];
-    }
-  }
-  for (int i = 0; i < flags.textureStageStates.size(); i++) {
-    for (int j = 0; j < flags.textureStageStates[i].size(); j++) {
-      if (flags.textureStageStates[i][j]) {
-        dst.textureStageStates[i][j] = src.textureStageStates[i][j];
-      }
-    }
+  flags.transforms.forEachSet([&](const size_t i) {
+    dst.transforms[i] = src.transforms[i];
+  });
+  for (size_t i = 0; i < flags.textureStageStates.size(); i++) {
+    flags.textureStageStates[i].forEachSet([&](const size_t j) {
+      dst.textureStageStates[i][j] = src.textureStageStates[i][j];
+    });
   }
   if (flags.viewport) {
     dst.viewport = src.viewport;
@@ -143,51 +139,25 @@ void Direct3DStateBlock9_LSS::StateTransfer(const BaseDirect3DDevice9Ex_LSS::Sta
   if (flags.scissorRect) {
     dst.scissorRect = src.scissorRect;
   }
-  for (int i = 0; i < flags.clipPlanes.size(); i++) {
-    if (flags.clipPlanes[i]) {
-      for (int j = 0; j < 4; j++) {
-        dst.clipPlanes[i][j] = src.clipPlanes[i][j];
-      }
-    }
-  }
-  for (int i = 0; i < flags.vertexConstants.fConsts.size(); i++) {
-    if (flags.vertexConstants.fConsts[i]) {
-      dst.vertexConstants.fConsts[i] = src.vertexConstants.fConsts[i];
-    }
-  }
-  for (int i = 0; i < flags.vertexConstants.iConsts.size(); i++) {
-    if (flags.vertexConstants.iConsts[i]) {
-      dst.vertexConstants.iConsts[i] = src.vertexConstants.iConsts[i];
-    }
-  }
-  for (int i = 0; i < flags.vertexConstants.bConsts.size(); i++) {
-    if (flags.vertexConstants.bConsts[i]) {
-      size_t dwordIndex = i / 32;
-      size_t dwordOffset = i % 32;
-      uint32_t bitMask = 1 << dwordOffset;
-      dst.vertexConstants.bConsts[dwordIndex]
-        = (src.vertexConstants.bConsts[dwordIndex] & bitMask) ? dst.vertexConstants.bConsts[dwordIndex] | bitMask : dst.vertexConstants.bConsts[dwordIndex] & ~bitMask;
+  flags.clipPlanes.forEachSet([&](const size_t i) {
+    for (int j = 0; j < 4; j++) {
+      dst.clipPlanes[i][j] = src.clipPlanes[i][j];
     }
-  }
-  for (int i = 0; i < flags.pixelConstants.fConsts.size(); i++) {
-    if (flags.pixelConstants.fConsts[i]) {
-      dst.pixelConstants.fConsts[i] = src.pixelConstants.fConsts[i];
-    }
-  }
-  for (int i = 0; i < flags.pixelConstants.iConsts.size(); i++) {
-    if (flags.pixelConstants.iConsts[i]) {
-      dst.pixelConstants.iConsts[i] = src.pixelConstants.iConsts[i];
-    }
-  }
-  for (int i = 0; i < flags.pixelConstants.bConsts.size(); i++) {
-    if (flags.pixelConstants.bConsts[i]) {
-      size_t dwordIndex = i / 32;
-      size_t dwordOffset = i % 32;
-      uint32_t bitMask = 1 << dwordOffset;
-      dst.pixelConstants.bConsts[dwordIndex]
-        = (src.pixelConstants.bConsts[dwordIndex] & bitMask) ? dst.pixelConstants.bConsts[dwordIndex] | bitMask : dst.pixelConstants.bConsts[dwordIndex] & ~bitMask;
-    }
-  }
+  });
+  flags.vertexConstants.fConsts.forEachSet([&](const size_t i) {
+    dst.vertexConstants.fConsts[i] = src.vertexConstants.fConsts[i];
+  });
+  flags.vertexConstants.iConsts.forEachSet([&](const size_t i) {
+    dst.vertexConstants.iConsts[i] = src.vertexConstants.iConsts[i];
+  });
+  transferBoolConstants(flags.vertexConstants.bConsts, src.vertexConstants.bConsts, dst.vertexConstants.bConsts);
+  flags.pixelConstants.fConsts.forEachSet([&](const size_t i) {
+    dst.pixelConstants.fConsts[i] = src.pixelConstants.fConsts[i];
+  });
+  flags.pixelConstants.iConsts.forEachSet([&](const size_t i) {
+    dst.pixelConstants.iConsts[i] = src.pixelConstants.iConsts[i];
+  });
+  transferBoolConstants(flags.pixelConstants.bConsts, src.pixelConstants.bConsts, dst.pixelConstants.bConsts);
 }
 
 void Direct3DStateBlock9_LSS::LocalCapture() {
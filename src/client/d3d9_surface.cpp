@@ -45,6 +45,9 @@ Direct3DSurface9_LSS::~Direct3DSurface9_LSS() {
     if (m_bufferId != SharedHeap::kInvalidId) {
       SharedHeap::deallocate(m_bufferId);
     }
+    if (m_readbackBufId != SharedHeap::kInvalidId) {
+      SharedHeap::deallocate(m_readbackBufId);
+    }
   } else if (m_shadow) {
     const auto surfaceSize =
       bridge_util::calcTotalSizeOfRect(m_desc.Width, m_desc.Height, m_desc.Format);
@@ -122,6 +125,15 @@ HRESULT Direct3DSurface9_LSS::GetDesc(D3DSURFACE_DESC* pDesc) {
 
 HRESULT Direct3DSurface9_LSS::LockRect(D3DLOCKED_RECT* pLockedRect, CONST RECT* pRect, DWORD Flags) {
   LogFunctionCall();
+  // We send LockRect() calls to server in cases wherein backbuffer is used to capture the screenshot.
+  // With the SharedHeap the server copies straight into the buffer the lock below hands out.
+  const bool bCapture =
+    m_isBackBuffer && ClientOptions::getEnableBackbufferCapture() && !(Flags & D3DLOCK_DISCARD);
+  const bool bReadback = bCapture && prepareReadback();
+  if (bReadback) {
+    ClientMessage c(Commands::IDirect3DSurface9_LockRect, getId(), kReadbackFlags);
+    sendReadbackTarget(c);
+  }
   // Store locked rect pointer locally so we can copy the data on unlock
   {
     BRIDGE_PARENT_DEVICE_LOCKGUARD();
@@ -133,8 +145,7 @@ HRESULT Direct3DSurface9_LSS::LockRect(D3DLOCKED_RECT* pLockedRect, CONST RECT*
     }
   }
 
-  // We send LockRect() calls to server in cases wherein backbuffer is used to capture the screenshot
-  if (m_isBackBuffer && ClientOptions::getEnableBackbufferCapture() && !(Flags & D3DLOCK_DISCARD)) {
+  if (bCapture && !bReadback) {
     UID currentUID;
     {
       ClientMessage c(Commands::IDirect3DSurface9_LockRect, getId());
@@ -210,6 +221,7 @@ bool Direct3DSurface9_LSS::lock(D3DLOCKED_RECT& lockedRect, const RECT* pRect, c
   if (m_bUseSharedHeap) {
     auto discardBufId = SharedHeap::kInvalidId;
     const bool bDiscard = (flags & D3DLOCK_DISCARD) != 0;
+    resolveReadback(bDiscard);
     if (bDiscard || (m_bufferId == SharedHeap::kInvalidId)) {
       discardBufId = m_bufferId;
       m_bufferId = SharedHeap::allocate(surfaceSize);
@@ -263,6 +275,27 @@ void* Direct3DSurface9_LSS::getBufPtr(const int pitch, const RECT& rect) {
 
 void Direct3DSurface9_LSS::sendDataToServer(const LockInfo& lockInfo) const {
   const auto dataFlag = m_bUseSharedHeap ? Commands::FlagBits::DataInSharedHeap : 0;
+  // Rects too large for the data queue are streamed ahead of the unlock,
+  // gathering the rows first unless the rect spans whole rows of the shadow
+  auto streamId = DeviceBridge::kNoStream;
+  if (!m_bUseSharedHeap) {
+    const auto [width, height] = getRectDimensions(lockInfo.rect);
+    const size_t totalSize = bridge_util::calcTotalSizeOfRect(width, height, m_desc.Format);
+    const size_t rowSize = bridge_util::calcRowSize(width, m_desc.Format);
+    if (DeviceBridge::needs_streaming(totalSize)) {
+      if (rowSize == (size_t) lockInfo.lockedRect.Pitch) {
+        streamId = DeviceBridge::send_stream_if_oversized(totalSize, lockInfo.lockedRect.pBits);
+      } else {
+        std::vector<uint8_t> rows(totalSize);
+        uint8_t* pRow = rows.data();
+        FOR_EACH_RECT_ROW(lockInfo.lockedRect, height, m_desc.Format, {
+          memcpy(pRow, ptr, rowSize);
+          pRow += rowSize;
+        });
+        streamId = DeviceBridge::send_stream_if_oversized(totalSize, rows.data());
+      }
+    }
+  }
   {
     ClientMessage c(Commands::IDirect3DSurface9_UnlockRect, getId(), dataFlag);
     c.send_data(sizeof(RECT), &lockInfo.rect);
@@ -276,7 +309,9 @@ void Direct3DSurface9_LSS::sendDataToServer(const LockInfo& lockInfo) const {
       const size_t totalSize = bridge_util::calcTotalSizeOfRect(width, height, m_desc.Format);
       const size_t rowSize = bridge_util::calcRowSize(width, m_desc.Format);
       c.send_data(rowSize);
-      if (auto* blobPacketPtr = c.begin_data_blob(totalSize)) {
+      if (streamId != DeviceBridge::kNoStream) {
+        c.send_data_or_stream(streamId, totalSize, nullptr);
+      } else if (auto* blobPacketPtr = c.begin_data_blob(totalSize)) {
         FOR_EACH_RECT_ROW(lockInfo.lockedRect, height, m_desc.Format, {
           memcpy(blobPacketPtr, ptr, rowSize);
           blobPacketPtr += rowSize;
@@ -293,6 +328,81 @@ void Direct3DSurface9_LSS::sendDataToServer(const LockInfo& lockInfo) const {
   }
 }
 
+bool Direct3DSurface9_LSS::prepareReadback() {
+  if (!m_bUseSharedHeap || !ClientOptions::getSharedHeapReadback()) {
+    return false;
+  }
+  // A newer readback supersedes the one in flight. The server is done with
+  // the old allocation before it processes its dealloc, so drop it now.
+  if (m_readbackBufId != SharedHeap::kInvalidId) {
+    SharedHeap::deallocate(m_readbackBufId);
+  }
+  const auto surfaceSize =
+    bridge_util::calcTotalSizeOfRect(m_desc.Width, m_desc.Height, m_desc.Format);
+  m_readbackBufId = SharedHeap::allocate(surfaceSize);
+  m_readbackFence = SharedHeap::kNullFence;
+  return m_readbackBufId != SharedHeap::kInvalidId;
+}
+
+bool Direct3DSurface9_LSS::canReadbackRenderTarget(const Direct3DSurface9_LSS* const pSource) const {
+  if (pSource == nullptr) {
+    return false;
+  }
+  const auto& srcDesc = pSource->m_desc;
+  return m_desc.Pool == D3DPOOL_SYSTEMMEM &&
+         srcDesc.MultiSampleType == D3DMULTISAMPLE_NONE &&
+         srcDesc.Format == m_desc.Format &&
+         srcDesc.Width == m_desc.Width &&
+         srcDesc.Height == m_desc.Height;
+}
+
+bool Direct3DSurface9_LSS::canReadbackFrontBuffer(const D3DPRESENT_PARAMETERS& presParams) const {
+  // In windowed mode the front buffer covers the desktop of the adapter the
+  // server presents on, which cannot be checked reliably from the client
+  if (presParams.Windowed) {
+    return false;
+  }
+  return m_desc.Pool == D3DPOOL_SYSTEMMEM &&
+         m_desc.Format == D3DFMT_A8R8G8B8 &&
+         m_desc.Width == presParams.BackBufferWidth &&
+         m_desc.Height == presParams.BackBufferHeight;
+}
+
+void Direct3DSurface9_LSS::sendReadbackTarget(ClientMessage& c) {
+  assert(m_readbackBufId != SharedHeap::kInvalidId);
+  // Fence must be issued while the command is being built so that fence
+  // order matches the order in which the server signals them
+  m_readbackFence = SharedHeap::issueFence();
+  c.send_many(m_readbackBufId, m_readbackFence);
+}
+
+void Direct3DSurface9_LSS::resolveReadback(const bool bDiscard) {
+  if (m_readbackBufId == SharedHeap::kInvalidId) {
+    return;
+  }
+  if (bDiscard) {
+    SharedHeap::deallocate(m_readbackBufId);
+  } else {
+    if (!SharedHeap::waitForFence(m_readbackFence)) {
+      Logger::err("[Direct3DSurface9_LSS][resolveReadback] Readback did not complete, surface contents are undefined.");
+    }
+    if (m_lockInfoQueue.empty()) {
+      if (m_bufferId != SharedHeap::kInvalidId) {
+        SharedHeap::deallocate(m_bufferId);
+      }
+      m_bufferId = m_readbackBufId;
+    } else {
+      // Outstanding locks still point into the current buffer
+      const auto surfaceSize =
+        bridge_util::calcTotalSizeOfRect(m_desc.Width, m_desc.Height, m_desc.Format);
+      memcpy(SharedHeap::getBuf(m_bufferId), SharedHeap::getBuf(m_readbackBufId), surfaceSize);
+      SharedHeap::deallocate(m_readbackBufId);
+    }
+  }
+  m_readbackBufId = SharedHeap::kInvalidId;
+  m_readbackFence = SharedHeap::kNullFence;
+}
+
 std::tuple<size_t, size_t> Direct3DSurface9_LSS::getRectDimensions(const RECT& rect) {
   return { rect.right  - rect.left,
            rect.bottom - rect.top  };
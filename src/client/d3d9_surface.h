@@ -47,6 +47,10 @@ class Direct3DSurface9_LSS: public Direct3DResource9_LSS<IDirect3DSurface9> {
     SharedHeap::AllocId discardBufId = SharedHeap::kInvalidId;
   };
   std::queue<LockInfo> m_lockInfoQueue;
+  // Readback of the server surface in flight into a SharedHeap allocation,
+  // adopted as m_bufferId once its fence is signaled
+  SharedHeap::AllocId m_readbackBufId = SharedHeap::kInvalidId;
+  SharedHeap::Fence m_readbackFence = SharedHeap::kNullFence;
 
   std::unique_ptr<uint8_t[]> m_shadow;
   inline static size_t g_totalSurfaceShadow = 0;
@@ -90,11 +94,26 @@ public:
     return m_desc;
   }
 
+  /*** SharedHeap readback ***/
+  static constexpr Commands::Flags kReadbackFlags =
+    Commands::FlagBits::DataInSharedHeap | Commands::FlagBits::DataHasFence;
+  // Reserves the allocation the server copies the surface into. Must be
+  // called before building the readback command, and if it returns true
+  // the command must be sent with kReadbackFlags and sendReadbackTarget().
+  bool prepareReadback();
+  void sendReadbackTarget(ClientMessage& c);
+  // The readback does not wait for the server, so calls D3D9 would reject
+  // with D3DERR_INVALIDCALL must be caught here. If these return false the
+  // copy has to go through the regular round trip instead.
+  bool canReadbackRenderTarget(const Direct3DSurface9_LSS* const pSource) const;
+  bool canReadbackFrontBuffer(const D3DPRESENT_PARAMETERS& presParams) const;
+
 private:
   /*** Lock/Unlock Functionality ***/
   bool m_isBackBuffer;
   bool lock(D3DLOCKED_RECT& lockedRect, const RECT* pRect, const DWORD& flags);
   void unlock();
+  void resolveReadback(const bool bDiscard);
   static RECT resolveLockInfoRect(const RECT* const pRect, const D3DSURFACE_DESC& desc);
   void* getBufPtr(const int pitch, const RECT& rect);
   void sendDataToServer(const LockInfo& lockInfo) const;
@@ -24,8 +24,11 @@
 #include "d3d9_swapchain.h"
 #include "d3d9_surface.h"
 #include "d3d9_surfacebuffer_helper.h"
+#include "remix_api.h"
 #include "swapchain_map.h"
 
+#include "util_metrics.h"
+
 extern std::mutex gSwapChainMapMutex;
 extern SwapChainMap gSwapChainMap;
 
@@ -168,6 +171,9 @@ HRESULT Direct3DSwapChain9_LSS::Present(CONST RECT* pSourceRect, CONST RECT* pDe
     return D3D_OK;
   }
 
+  // Remix API instances drawn this frame must reach the server before its Present
+  remixapi::flushInstanceBatch();
+
   // Send present first
   {
     ClientMessage c(Commands::IDirect3DSwapChain9_Present, getId());
@@ -177,6 +183,7 @@ HRESULT Direct3DSwapChain9_LSS::Present(CONST RECT* pSourceRect, CONST RECT* pDe
     c.send_data(sizeof(RGNDATA), (void*) pDirtyRegion);
     c.send_data(dwFlags);
   }
+  DeviceBridge::getWriterChannel().writerFrameCount->fetch_add(1, std::memory_order_relaxed);
 
   extern HRESULT syncOnPresent();
   const auto syncResult = syncOnPresent();
@@ -184,7 +191,11 @@ HRESULT Direct3DSwapChain9_LSS::Present(CONST RECT* pSourceRect, CONST RECT* pDe
     return ERROR_SEM_TIMEOUT;
   }
 
+  extern void LogTimeToFirstFrame();
+  LogTimeToFirstFrame();
+
   FrameMark;
+  Metrics::endFrame();
 
   return D3D_OK;
 }
@@ -195,11 +206,21 @@ HRESULT Direct3DSwapChain9_LSS::GetFrontBufferData(IDirect3DSurface9* pDestSurfa
   const auto pLssDestinationSurface = bridge_cast<Direct3DSurface9_LSS*>(pDestSurface);
   const auto pIDestinationSurface = pLssDestinationSurface->D3D<IDirect3DSurface9>();
 
+  const bool bReadback =
+    pLssDestinationSurface->canReadbackFrontBuffer(m_presParam) &&
+    pLssDestinationSurface->prepareReadback();
   UID currentUID = 0;
   {
-    ClientMessage c(Commands::IDirect3DSwapChain9_GetFrontBufferData, getId());
+    ClientMessage c(Commands::IDirect3DSwapChain9_GetFrontBufferData, getId(),
+                    bReadback ? Direct3DSurface9_LSS::kReadbackFlags : 0);
     currentUID = c.get_uid();
     c.send_data((uint32_t) pIDestinationSurface);
+    if (bReadback) {
+      pLssDestinationSurface->sendReadbackTarget(c);
+    }
+  }
+  if (bReadback) {
+    return D3D_OK;
   }
 
   return copyServerSurfaceRawData(pLssDestinationSurface, currentUID);
@@ -55,7 +55,11 @@ ULONG Direct3DVertexDeclaration9_LSS::Release() {
 }
 
 void Direct3DVertexDeclaration9_LSS::onDestroy() {
-  ClientMessage { Commands::IDirect3DVertexDeclaration9_Destroy, getId() };
+  if (m_pInterner) {
+    m_pInterner->release(m_internHash);
+  } else {
+    ClientMessage { Commands::IDirect3DVertexDeclaration9_Destroy, getId() };
+  }
 }
 
 HRESULT Direct3DVertexDeclaration9_LSS::GetDevice(IDirect3DDevice9** ppDevice) {
@@ -78,3 +82,39 @@ HRESULT Direct3DVertexDeclaration9_LSS::GetDeclaration(D3DVERTEXELEMENT9* pEleme
 
   return S_OK;
 }
+
+size_t VertexDeclarationInterner::acquire(const uint64_t hash, const D3DVERTEXELEMENT9* const pElements,
+                                          const size_t numElem, bool& bCreate) {
+  std::scoped_lock lock(m_mutex);
+  auto it = m_entries.find(hash);
+  if (it != m_entries.end()) {
+    auto& entry = it->second;
+    if (entry.elements.size() != numElem ||
+        memcmp(entry.elements.data(), pElements, numElem * sizeof(D3DVERTEXELEMENT9)) != 0) {
+      return 0;
+    }
+    ++entry.numRefs;
+    bCreate = false;
+    return entry.serverId;
+  }
+  const size_t serverId = D3dBaseIdFactory::getNextId();
+  m_entries.emplace(hash, Entry { serverId, { pElements, pElements + numElem }, 1 });
+  bCreate = true;
+  return serverId;
+}
+
+void VertexDeclarationInterner::release(const uint64_t hash) {
+  std::scoped_lock lock(m_mutex);
+  auto it = m_entries.find(hash);
+  assert(it != m_entries.end());
+  if (it == m_entries.end() || --it->second.numRefs > 0) {
+    return;
+  }
+  // Destroyed while locked, so a new declaration with the same elements is created after it
+  const size_t serverId = it->second.serverId;
+  m_entries.erase(it);
+  {
+    ClientMessage { Commands::IDirect3DVertexDeclaration9_Destroy, serverId };
+  }
+  D3dBaseIdFactory::releaseId(serverId);
+}
@@ -25,11 +25,39 @@
 #include "base.h"
 #include "d3d9_device_base.h"
 
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 #include <vector>
 
+// Shares one server side declaration between all declarations a device creates from
+// the same element array. Each create still returns its own client object, only the
+// server handle is shared, and it is destroyed with the last declaration using it.
+class VertexDeclarationInterner {
+public:
+  // Returns the server handle for the element array, or 0 if another array with the
+  // same hash is interned already. bCreate is set if the server object does not exist yet.
+  size_t acquire(const uint64_t hash, const D3DVERTEXELEMENT9* const pElements,
+                 const size_t numElem, bool& bCreate);
+  void release(const uint64_t hash);
+
+private:
+  struct Entry {
+    size_t serverId;
+    std::vector<D3DVERTEXELEMENT9> elements;
+    uint32_t numRefs;
+  };
+  std::mutex m_mutex;
+  std::unordered_map<uint64_t, Entry> m_entries;
+};
+
 class Direct3DVertexDeclaration9_LSS: public D3DBase<IDirect3DVertexDeclaration9> {
   void onDestroy() override;
   std::vector<D3DVERTEXELEMENT9> m_elements;
+  // Interned declarations keep the interner alive, it may outlive the device
+  std::shared_ptr<VertexDeclarationInterner> m_pInterner;
+  uint64_t m_internHash = 0;
+  size_t m_serverId = 0;
 
 protected:
   BaseDirect3DDevice9Ex_LSS* const m_pDevice = nullptr;
@@ -44,6 +72,25 @@ public:
       ++counter;
     }
     m_elements.push_back(*counter);
+    m_serverId = getId();
+  }
+
+  Direct3DVertexDeclaration9_LSS(BaseDirect3DDevice9Ex_LSS* const pDevice, CONST D3DVERTEXELEMENT9* pVertexElements,
+                                 std::shared_ptr<VertexDeclarationInterner> pInterner,
+                                 const uint64_t internHash, const size_t serverId)
+    : Direct3DVertexDeclaration9_LSS(pDevice, pVertexElements) {
+    m_pInterner = std::move(pInterner);
+    m_internHash = internHash;
+    m_serverId = serverId;
+  }
+
+  const std::vector<D3DVERTEXELEMENT9>& getElements() const {
+    return m_elements;
+  }
+
+  // Handle the server knows the declaration by
+  size_t getServerId() const {
+    return m_serverId;
   }
 
   /*** IUnknown methods ***/
@@ -22,12 +22,15 @@
 #pragma once
 
 #include "util_bridgecommand.h"
+#include "util_hash.h"
 #include "util_sharedheap.h"
 
 #include "d3d9_util.h"
 
 #include <d3d9.h>
+#include <algorithm>
 #include <queue>
+#include <vector>
 
 template <typename T>
 class LockableBuffer: public Direct3DResource9_LSS<T> {
@@ -38,6 +41,8 @@ class LockableBuffer: public Direct3DResource9_LSS<T> {
     Commands::IDirect3DVertexBuffer9_Unlock : Commands::IDirect3DIndexBuffer9_Unlock;
   static constexpr size_t kSIMDAlign = 16;
   static constexpr uint32_t kLockCheckValue = 0xbaadf00d;
+  static constexpr size_t kNoRingSlot = (size_t) -1;
+  static constexpr size_t kHashPageSize = 4096;
   using DescType = std::conditional_t<bIsVertexBuffer, D3DVERTEXBUFFER_DESC, D3DINDEXBUFFER_DESC>;
 
   struct LockInfo {
@@ -48,6 +53,7 @@ class LockableBuffer: public Direct3DResource9_LSS<T> {
     uint32_t* checkPtr;
     SharedHeap::AllocId bufferId = SharedHeap::kInvalidId;
     SharedHeap::AllocId discardedBufferId = SharedHeap::kInvalidId;
+    size_t ringSlot = kNoRingSlot;
   };
   std::queue<LockInfo> m_lockInfos;
 
@@ -55,6 +61,30 @@ class LockableBuffer: public Direct3DResource9_LSS<T> {
   std::unique_ptr<uint8_t[]> m_shadow;
   inline static size_t g_totalBufferShadow = 0;
 
+  // Dynamic buffers on the SharedHeap cycle through a small ring of regions on
+  // D3DLOCK_DISCARD. Each region carries the fence of the last Unlock that
+  // referenced it and may be handed out again once the server signaled it.
+  struct RingSlot {
+    SharedHeap::AllocId bufferId = SharedHeap::kInvalidId;
+    SharedHeap::Fence fence = SharedHeap::kNullFence;
+  };
+  std::vector<RingSlot> m_ring;
+  size_t m_ringPos = 0;
+  const uint32_t m_maxRingSize = 0;
+
+  // Written [begin, end) ranges of NOOVERWRITE locks not yet sent to the server,
+  // kept sorted and non-overlapping.
+  struct DirtyRange {
+    uint32_t begin;
+    uint32_t end;
+  };
+  std::vector<DirtyRange> m_pendingRanges;
+  const bool m_coalesceNoOverwrite = false;
+
+  // Per-page content hashes of static buffers, valid once the whole buffer has been sent
+  const bool m_pageHashing = false;
+  std::vector<uint64_t> m_pageHashes;
+
 public:
   DescType getDesc() {
     return m_desc;
@@ -71,6 +101,156 @@ private:
     }
   }
 
+  static uint32_t getRingSizePolicy(const DescType& desc, const bool bUseSharedHeap) {
+    if (bUseSharedHeap && (desc.Usage & D3DUSAGE_DYNAMIC)) {
+      return GlobalOptions::getSharedHeapDynamicBufferRingSize();
+    }
+    return 0;
+  }
+
+  bool isRingBuffered() const {
+    return m_maxRingSize > 1;
+  }
+
+  SharedHeap::AllocId acquireRingSlot() {
+    // Prefer any region the server is already done with, starting after the current one
+    for (size_t i = 1; i <= m_ring.size(); ++i) {
+      const size_t pos = (m_ringPos + i) % m_ring.size();
+      if (SharedHeap::isFenceSignaled(m_ring[pos].fence)) {
+        m_ringPos = pos;
+        return m_ring[pos].bufferId;
+      }
+    }
+    // Grow the ring while allowed
+    if (m_ring.size() < m_maxRingSize) {
+      const auto bufferId = SharedHeap::allocate(m_desc.Size);
+      if (bufferId == SharedHeap::kInvalidId) {
+        return SharedHeap::kInvalidId;
+      }
+      m_ring.push_back({ bufferId, SharedHeap::kNullFence });
+      m_ringPos = m_ring.size() - 1;
+      return bufferId;
+    }
+    // Ring is saturated, wait for the oldest region to be consumed
+    const size_t pos = (m_ringPos + 1) % m_ring.size();
+    if (!SharedHeap::waitForFence(m_ring[pos].fence)) {
+      // Server is not making progress, so swap the region out rather than stall.
+      // Dealloc is processed by the server in order, so pending unlocks stay valid.
+      Logger::warn(format_string("[LockableBuffer][Lock] Replacing busy ring region of %s buffer [%p]",
+                                 bIsVertexBuffer ? "vertex" : "index", this));
+      SharedHeap::deallocate(m_ring[pos].bufferId);
+      m_ring[pos] = { SharedHeap::allocate(m_desc.Size), SharedHeap::kNullFence };
+      if (m_ring[pos].bufferId == SharedHeap::kInvalidId) {
+        m_ring.erase(m_ring.begin() + pos);
+        m_ringPos = 0;
+        return SharedHeap::kInvalidId;
+      }
+    }
+    m_ringPos = pos;
+    return m_ring[pos].bufferId;
+  }
+
+  bool isDeferredUnlock(const DWORD flags) const {
+    return m_coalesceNoOverwrite &&
+           (flags & (D3DLOCK_NOOVERWRITE | D3DLOCK_DISCARD | D3DLOCK_READONLY)) == D3DLOCK_NOOVERWRITE;
+  }
+
+  void addPendingRange(const uint32_t begin, const uint32_t end) {
+    DirtyRange range { begin, end };
+    auto it = std::lower_bound(m_pendingRanges.begin(), m_pendingRanges.end(), range,
+                               [](const DirtyRange& a, const DirtyRange& b) { return a.end < b.begin; });
+    // Absorb every range overlapping or adjacent to the new one
+    auto last = it;
+    while (last != m_pendingRanges.end() && last->begin <= range.end) {
+      range.begin = std::min(range.begin, last->begin);
+      range.end = std::max(range.end, last->end);
+      ++last;
+    }
+    it = m_pendingRanges.erase(it, last);
+    m_pendingRanges.insert(it, range);
+  }
+
+  void sendUnlock(const LockInfo& lockInfo, const uint32_t offset, const size_t size, void* ptr) {
+    Commands::Flags cmdFlags = 0;
+    const bool bFenced = m_bUseSharedHeap &&
+                         lockInfo.ringSlot < m_ring.size() &&
+                         m_ring[lockInfo.ringSlot].bufferId == lockInfo.bufferId;
+
+    if (m_bUseSharedHeap) {
+      cmdFlags = Commands::FlagBits::DataInSharedHeap;
+      if (bFenced) {
+        cmdFlags = (Commands::Flags) (cmdFlags | Commands::FlagBits::DataHasFence);
+      }
+    } else if (m_optimizedLock) {
+      cmdFlags = Commands::FlagBits::DataIsReserved;
+
+      if (kLockCheckValue != *lockInfo.checkPtr) {
+        Logger::err("Fatal: reserved buffer region has been corrupted! "
+                    "Application will now exit.");
+        throw;
+      }
+    }
+
+    const auto streamId = (m_bUseSharedHeap || m_optimizedLock) ?
+      DeviceBridge::kNoStream : DeviceBridge::send_stream_if_oversized(size, ptr);
+
+    // Send the buffer lock parameters and handle
+    ClientMessage c(UnlockCmd, getId(), cmdFlags);
+    c.send_many(offset, size, lockInfo.flags);
+
+    if (m_bUseSharedHeap) {
+      c.send_data(lockInfo.bufferId);
+      if (bFenced) {
+        // Fence must be issued while the command is being built so that
+        // fence order matches the order in which the server consumes them
+        const auto fence = SharedHeap::issueFence();
+        m_ring[lockInfo.ringSlot].fence = fence;
+        c.send_data(fence);
+      }
+    } else if (m_optimizedLock) {
+      // Now send data offset in the channel
+      const uint32_t dataOffset = static_cast<uint32_t*>(ptr) -
+        DeviceBridge::getWriterChannel().get_data_ptr();
+      c.send_many(dataOffset);
+    } else {
+      // Now send the buffer bytes
+      c.send_data_or_stream(streamId, size, ptr);
+    }
+  }
+
+  // Sends every page of the buffer whose contents changed since the last unlock,
+  // coalescing runs of consecutive changed pages into a single command.
+  void sendChangedPages(const LockInfo& lockInfo) {
+    const uint8_t* const base = m_bUseSharedHeap ?
+      SharedHeap::getBuf(lockInfo.bufferId) : m_shadow.get();
+    const size_t numPages = (m_desc.Size + kHashPageSize - 1) / kHashPageSize;
+    const bool bHashesValid = !m_pageHashes.empty();
+    if (!bHashesValid) {
+      m_pageHashes.resize(numPages);
+    }
+
+    size_t runBegin = numPages;
+    for (size_t page = 0; page <= numPages; ++page) {
+      bool bChanged = false;
+      if (page < numPages) {
+        const size_t pageOffset = page * kHashPageSize;
+        const size_t pageSize = std::min(kHashPageSize, m_desc.Size - pageOffset);
+        const uint64_t hash = bridge_util::MemoryHash::hash(base + pageOffset, pageSize);
+        bChanged = !bHashesValid || hash != m_pageHashes[page];
+        m_pageHashes[page] = hash;
+      }
+      if (bChanged && runBegin == numPages) {
+        runBegin = page;
+      } else if (!bChanged && runBegin != numPages) {
+        const uint32_t offset = (uint32_t) (runBegin * kHashPageSize);
+        const size_t size = std::min(page * kHashPageSize, (size_t) m_desc.Size) - offset;
+        void* const ptr = m_bUseSharedHeap ? nullptr : m_shadow.get() + offset;
+        sendUnlock(lockInfo, offset, size, ptr);
+        runBegin = numPages;
+      }
+    }
+  }
+
   void initShadowMem() {
     m_shadow = std::make_unique<uint8_t[]>(m_desc.Size);
     g_totalBufferShadow += m_desc.Size;
@@ -90,8 +270,13 @@ protected:
     : Direct3DResource9_LSS<T>(pD3dBuf, pDevice)
     , m_desc(desc)
     , m_bUseSharedHeap(getSharedHeapPolicy(m_desc))
-    , m_sendWhole((desc.Usage& D3DUSAGE_DYNAMIC) == 0 && GlobalOptions::getAlwaysCopyEntireStaticBuffer())
-    , m_optimizedLock((desc.Usage& D3DUSAGE_DYNAMIC) != 0 && ClientOptions::getOptimizedDynamicLock()) {
+    , m_sendWhole((desc.Usage& D3DUSAGE_DYNAMIC) == 0 && GlobalOptions::getAlwaysCopyEntireStaticBuffer() &&
+                  !GlobalOptions::getStaticBufferPageHashing())
+    , m_optimizedLock((desc.Usage& D3DUSAGE_DYNAMIC) != 0 && ClientOptions::getOptimizedDynamicLock())
+    , m_maxRingSize(getRingSizePolicy(desc, getSharedHeapPolicy(desc)))
+    , m_coalesceNoOverwrite((desc.Usage& D3DUSAGE_DYNAMIC) != 0 && !ClientOptions::getOptimizedDynamicLock() &&
+                            ClientOptions::getCoalesceNoOverwriteLocks())
+    , m_pageHashing((desc.Usage& D3DUSAGE_DYNAMIC) == 0 && GlobalOptions::getStaticBufferPageHashing()) {
     if (!m_bUseSharedHeap) {
       initShadowMem();
     }
@@ -99,7 +284,11 @@ protected:
 
   ~LockableBuffer() {
     if (m_bUseSharedHeap) {
-      if (m_bufferId != SharedHeap::kInvalidId) {
+      if (isRingBuffered()) {
+        for (const auto& slot : m_ring) {
+          SharedHeap::deallocate(slot.bufferId);
+        }
+      } else if (m_bufferId != SharedHeap::kInvalidId) {
         SharedHeap::deallocate(m_bufferId);
       }
     } else if (m_shadow) {
@@ -118,16 +307,33 @@ protected:
 
     uint32_t* checkPtr = nullptr;
 
+    // Pending NOOVERWRITE updates refer to the current contents, so they must
+    // reach the server before anything else may change or replace them.
+    if (!isDeferredUnlock(flags)) {
+      flushPendingRanges();
+    }
+
     if (m_bUseSharedHeap) {
       SharedHeap::AllocId discardedBufferId = SharedHeap::kInvalidId;
+      size_t ringSlot = kNoRingSlot;
       const bool bDiscard = (flags & D3DLOCK_DISCARD) != 0;
-      if (bDiscard && (m_bufferId != SharedHeap::kInvalidId)) {
-        // If D3DLOCK_DISCARD is an active flag, we must begin the process of dealloc'ing
-        // and freeing that buffer from the shared heap
-        discardedBufferId = m_bufferId;
+      SharedHeap::AllocId nextBufId = m_bufferId;
+      if (isRingBuffered()) {
+        // Discarded regions stay in the ring and get recycled once consumed
+        if (bDiscard || (m_bufferId == SharedHeap::kInvalidId)) {
+          nextBufId = acquireRingSlot();
+        }
+        ringSlot = m_ringPos;
+      } else {
+        if (bDiscard && (m_bufferId != SharedHeap::kInvalidId)) {
+          // If D3DLOCK_DISCARD is an active flag, we must begin the process of dealloc'ing
+          // and freeing that buffer from the shared heap
+          discardedBufferId = m_bufferId;
+        }
+        if (bDiscard || (m_bufferId == SharedHeap::kInvalidId)) {
+          nextBufId = SharedHeap::allocate(m_desc.Size);
+        }
       }
-      const auto nextBufId = (bDiscard || (m_bufferId == SharedHeap::kInvalidId)) ?
-        m_bufferId = SharedHeap::allocate(m_desc.Size) : m_bufferId;
       if (nextBufId == SharedHeap::kInvalidId) {
         std::stringstream ss;
         ss << "[LockableBuffer][Lock] Failed to allocate on SharedHeap: {";
@@ -141,7 +347,7 @@ protected:
       }
       m_bufferId = nextBufId;
       *ppbData = SharedHeap::getBuf(m_bufferId) + offset;
-      m_lockInfos.push({ offset, size, nullptr, flags, checkPtr, m_bufferId, discardedBufferId });
+      m_lockInfos.push({ offset, size, nullptr, flags, checkPtr, m_bufferId, discardedBufferId, ringSlot });
     } else {
       *ppbData = m_shadow.get() + offset;
 
@@ -190,36 +396,12 @@ protected:
 
     // If this is a read only access then don't bother sending
     if ((lockInfo.flags & D3DLOCK_READONLY) == 0) {
-      {
-        Commands::Flags cmdFlags = 0;
-
-        if (m_bUseSharedHeap) {
-          cmdFlags = Commands::FlagBits::DataInSharedHeap;
-        } else if (m_optimizedLock) {
-          cmdFlags = Commands::FlagBits::DataIsReserved;
-
-          if (kLockCheckValue != *lockInfo.checkPtr) {
-            Logger::err("Fatal: reserved buffer region has been corrupted! "
-                        "Application will now exit.");
-            throw;
-          }
-        }
-
-        // Send the buffer lock parameters and handle
-        ClientMessage c(UnlockCmd, getId(), cmdFlags);
-        c.send_many(offset, size, lockInfo.flags);
-
-        if (m_bUseSharedHeap) {
-          c.send_data(lockInfo.bufferId);
-        } else if (m_optimizedLock) {
-          // Now send data offset in the channel
-          const uint32_t dataOffset = static_cast<uint32_t*>(ptr) -
-            DeviceBridge::getWriterChannel().get_data_ptr();
-          c.send_many(dataOffset);
-        } else {
-          // Now send the buffer bytes
-          c.send_data(size, ptr);
-        }
+      if (m_pageHashing) {
+        sendChangedPages(lockInfo);
+      } else if (isDeferredUnlock(lockInfo.flags) && !m_sendWhole) {
+        addPendingRange(offset, offset + (uint32_t) size);
+      } else {
+        sendUnlock(lockInfo, offset, size, ptr);
       }
       if (lockInfo.discardedBufferId != SharedHeap::kInvalidId) {
         SharedHeap::deallocate(lockInfo.discardedBufferId);
@@ -227,4 +409,22 @@ protected:
     }
     m_lockInfos.pop();
   }
+
+public:
+  // Sends the merged NOOVERWRITE updates that were held back on Unlock.
+  // Must be called before the server may consume the buffer contents.
+  void flushPendingRanges() {
+    if (m_pendingRanges.empty()) {
+      return;
+    }
+    for (const auto& range : m_pendingRanges) {
+      const size_t size = range.end - range.begin;
+      void* ptr = m_bUseSharedHeap ? nullptr : m_shadow.get() + range.begin;
+      const LockInfo lockInfo { range.begin, (UINT) size, ptr, D3DLOCK_NOOVERWRITE, nullptr,
+                                m_bufferId, SharedHeap::kInvalidId,
+                                isRingBuffered() ? m_ringPos : kNoRingSlot };
+      sendUnlock(lockInfo, range.begin, size, ptr);
+    }
+    m_pendingRanges.clear();
+  }
 };
\ No newline at end of file
@@ -0,0 +1,377 @@
+/*
+ * Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#include "pch.h"
+#include "module_query_cache.h"
+
+#include "version.h"
+
+#include "client_options.h"
+#include "log/log.h"
+#include "util_filesys.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+extern std::string gRemixFolder;
+
+namespace {
+  constexpr char kMagic[4] = { 'B', 'R', 'Q', 'C' };
+  constexpr uint32_t kVersion = 1;
+  constexpr const char* kFileName = "bridge_query_cache.bin";
+  // Upper bound on a single stored result, D3DADAPTER_IDENTIFIER9 being the largest one
+  constexpr uint32_t kMaxPayloadSize = 4096;
+
+  // Identifies the renderer and bridge build a persisted file was written by
+  struct FileHeader {
+    char magic[4];
+    uint32_t version;
+    char bridgeVersion[32];
+    uint64_t rendererSize;
+    int64_t rendererTimestamp;
+    uint32_t numAdapters;
+  };
+
+  // The parts of D3DADAPTER_IDENTIFIER9 that change with the GPU or its driver
+  struct AdapterIdentity {
+    uint64_t driverVersion;
+    uint32_t vendorId;
+    uint32_t deviceId;
+    uint32_t subSysId;
+    uint32_t revision;
+    GUID deviceIdentifier;
+
+    bool operator==(const AdapterIdentity& other) const {
+      return memcmp(this, &other, sizeof(AdapterIdentity)) == 0;
+    }
+  };
+
+  struct EntryHeader {
+    uint32_t command;
+    uint32_t args[ModuleQueryCache::kMaxArgs];
+    HRESULT hresult;
+    uint32_t payloadSize;
+  };
+
+  struct Entry {
+    HRESULT hresult;
+    std::vector<uint8_t> payload;
+  };
+
+  struct KeyHash {
+    size_t operator()(const ModuleQueryCache::Key& key) const {
+      size_t hash = std::hash<uint32_t>{}(key.command);
+      for (const uint32_t arg : key.args) {
+        hash ^= std::hash<uint32_t>{}(arg) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+      }
+      return hash;
+    }
+  };
+
+  using EntryMap = std::unordered_map<ModuleQueryCache::Key, Entry, KeyHash>;
+
+  struct PendingAdapter {
+    AdapterIdentity identity;
+    EntryMap entries;
+  };
+
+  std::mutex gMutex;
+  EntryMap gEntries;
+  // Persisted results waiting for their adapter to be validated
+  std::unordered_map<UINT, PendingAdapter> gPending;
+  // Live identities of the adapters seen in this run
+  std::unordered_map<UINT, AdapterIdentity> gIdentities;
+  std::unordered_set<UINT> gValidationRequested;
+  bool gLoaded = false;
+  bool gDirty = false;
+
+  bool dependsOnDisplayMode(const Commands::D3D9Command command) {
+    switch (command) {
+    case Commands::IDirect3D9Ex_GetAdapterModeCount:
+    case Commands::IDirect3D9Ex_EnumAdapterModes:
+    case Commands::IDirect3D9Ex_GetAdapterDisplayMode:
+    case Commands::IDirect3D9Ex_GetAdapterModeCountEx:
+    case Commands::IDirect3D9Ex_EnumAdapterModesEx:
+      return true;
+    default:
+      return false;
+    }
+  }
+
+  UINT getAdapter(const ModuleQueryCache::Key& key) {
+    return key.args[0];
+  }
+
+  AdapterIdentity toIdentity(const D3DADAPTER_IDENTIFIER9& identifier) {
+    AdapterIdentity identity;
+    memset(&identity, 0, sizeof(identity));
+    identity.driverVersion = identifier.DriverVersion.QuadPart;
+    identity.vendorId = identifier.VendorId;
+    identity.deviceId = identifier.DeviceId;
+    identity.subSysId = identifier.SubSysId;
+    identity.revision = identifier.Revision;
+    identity.deviceIdentifier = identifier.DeviceIdentifier;
+    return identity;
+  }
+
+  std::filesystem::path getCachePath() {
+    using namespace dxvk::util;
+    return RtxFileSys::path(RtxFileSys::Mods).parent_path() / kFileName;
+  }
+
+  // Stamps the header with the bridge version and the size and modification
+  // time of the renderer the server loads, so that a renderer update
+  // invalidates everything persisted by the previous one.
+  FileHeader makeHeader(const uint32_t numAdapters) {
+    FileHeader header;
+    memset(&header, 0, sizeof(header));
+    std::copy(std::begin(kMagic), std::end(kMagic), header.magic);
+    header.version = kVersion;
+    strncpy_s(header.bridgeVersion, BRIDGE_VERSION, _TRUNCATE);
+    const std::filesystem::path rendererPath = gRemixFolder + ".trex/d3d9.dll";
+    std::error_code ec;
+    header.rendererSize = std::filesystem::file_size(rendererPath, ec);
+    if (ec) {
+      header.rendererSize = 0;
+    }
+    const auto writeTime = std::filesystem::last_write_time(rendererPath, ec);
+    header.rendererTimestamp = ec ? 0 : writeTime.time_since_epoch().count();
+    header.numAdapters = numAdapters;
+    return header;
+  }
+
+  // gMutex must be held
+  void load() {
+    gLoaded = true;
+    if (!ClientOptions::getPersistQueryCache()) {
+      return;
+    }
+
+    const auto cachePath = getCachePath();
+    FILE* pFile = nullptr;
+    if (fopen_s(&pFile, cachePath.string().c_str(), "rb") != 0 || pFile == nullptr) {
+      Logger::info("[QueryCache] No persisted query cache found.");
+      return;
+    }
+
+    FileHeader header;
+    const FileHeader expected = makeHeader(0);
+    if (fread(&header, sizeof(header), 1, pFile) != 1 ||
+        memcmp(header.magic, expected.magic, sizeof(kMagic)) != 0 ||
+        header.version != expected.version ||
+        strncmp(header.bridgeVersion, expected.bridgeVersion, sizeof(header.bridgeVersion)) != 0 ||
+        header.rendererSize != expected.rendererSize ||
+        header.rendererTimestamp != expected.rendererTimestamp) {
+      Logger::info("[QueryCache] Persisted query cache is stale, discarding it.");
+      fclose(pFile);
+      return;
+    }
+
+    size_t numEntries = 0;
+    bool valid = true;
+    for (uint32_t i = 0; i < header.numAdapters && valid; ++i) {
+      uint32_t adapter = 0;
+      uint32_t count = 0;
+      PendingAdapter pending;
+      valid = fread(&adapter, sizeof(adapter), 1, pFile) == 1 &&
+              fread(&pending.identity, sizeof(pending.identity), 1, pFile) == 1 &&
+              fread(&count, sizeof(count), 1, pFile) == 1;
+      for (uint32_t j = 0; j < count && valid; ++j) {
+        EntryHeader entryHeader;
+        valid = fread(&entryHeader, sizeof(entryHeader), 1, pFile) == 1 &&
+                entryHeader.payloadSize <= kMaxPayloadSize &&
+                entryHeader.command < Commands::Bridge_CommandCount;
+        if (!valid) {
+          break;
+        }
+        ModuleQueryCache::Key key { (Commands::D3D9Command) entryHeader.command, {} };
+        std::copy(std::begin(entryHeader.args), std::end(entryHeader.args), key.args.begin());
+        Entry& entry = pending.entries[key];
+        entry.hresult = entryHeader.hresult;
+        entry.payload.resize(entryHeader.payloadSize);
+        valid = entryHeader.payloadSize == 0 ||
+                fread(entry.payload.data(), entryHeader.payloadSize, 1, pFile) == 1;
+      }
+      if (valid) {
+        numEntries += pending.entries.size();
+        gPending[adapter] = std::move(pending);
+      }
+    }
+    fclose(pFile);
+
+    if (!valid) {
+      Logger::warn("[QueryCache] Persisted query cache is corrupt, discarding it.");
+      gPending.clear();
+      return;
+    }
+    Logger::info(format_string("[QueryCache] Loaded %zu persisted results for %zu adapters.",
+                               numEntries, gPending.size()));
+  }
+
+  // gMutex must be held
+  void ensureLoaded() {
+    if (!gLoaded) {
+      load();
+    }
+  }
+}
+
+bool ModuleQueryCache::find(const Key& key, HRESULT& hresult, void* pData, const size_t dataSize) {
+  if (!ClientOptions::getQueryCache()) {
+    return false;
+  }
+  std::scoped_lock lock(gMutex);
+  ensureLoaded();
+  const auto it = gEntries.find(key);
+  if (it == gEntries.end() || it->second.payload.size() != dataSize) {
+    return false;
+  }
+  hresult = it->second.hresult;
+  if (dataSize > 0) {
+    memcpy(pData, it->second.payload.data(), dataSize);
+  }
+  return true;
+}
+
+void ModuleQueryCache::store(const Key& key, const HRESULT hresult, const void* pData, const size_t dataSize) {
+  if (!ClientOptions::getQueryCache()) {
+    return;
+  }
+  std::scoped_lock lock(gMutex);
+  Entry& entry = gEntries[key];
+  entry.hresult = hresult;
+  entry.payload.assign((const uint8_t*) pData, (const uint8_t*) pData + dataSize);
+  gDirty |= !dependsOnDisplayMode(key.command);
+}
+
+bool ModuleQueryCache::needsValidation(const UINT adapter) {
+  if (!ClientOptions::getQueryCache() || !ClientOptions::getPersistQueryCache()) {
+    return false;
+  }
+  std::scoped_lock lock(gMutex);
+  ensureLoaded();
+  // Only ask once per adapter so a failing identifier query is not retried on every call
+  return gIdentities.find(adapter) == gIdentities.end() && gValidationRequested.insert(adapter).second;
+}
+
+void ModuleQueryCache::validateAdapter(const UINT adapter, const D3DADAPTER_IDENTIFIER9& identifier) {
+  if (!ClientOptions::getQueryCache()) {
+    return;
+  }
+  std::scoped_lock lock(gMutex);
+  const AdapterIdentity identity = toIdentity(identifier);
+  gIdentities[adapter] = identity;
+
+  const auto it = gPending.find(adapter);
+  if (it == gPending.end()) {
+    return;
+  }
+  if (it->second.identity == identity) {
+    // Results fetched live during this run take precedence
+    gEntries.merge(it->second.entries);
+    Logger::info(format_string("[QueryCache] Reusing persisted results for adapter %u.", adapter));
+  } else {
+    Logger::info(format_string("[QueryCache] GPU or driver of adapter %u changed, discarding its persisted results.", adapter));
+    gDirty = true;
+  }
+  gPending.erase(it);
+}
+
+void ModuleQueryCache::invalidateDisplayModes(const char* reason) {
+  if (!ClientOptions::getQueryCache()) {
+    return;
+  }
+  std::scoped_lock lock(gMutex);
+  size_t numErased = 0;
+  for (auto it = gEntries.begin(); it != gEntries.end();) {
+    if (dependsOnDisplayMode(it->first.command)) {
+      it = gEntries.erase(it);
+      ++numErased;
+    } else {
+      ++it;
+    }
+  }
+  if (numErased > 0) {
+    Logger::debug(format_string("[QueryCache] Dropped %zu display mode results: %s", numErased, reason));
+  }
+}
+
+void ModuleQueryCache::save() {
+  if (!ClientOptions::getQueryCache() || !ClientOptions::getPersistQueryCache()) {
+    return;
+  }
+  std::scoped_lock lock(gMutex);
+  if (!gDirty) {
+    return;
+  }
+
+  // Only results for adapters whose identity is known can be persisted, and
+  // persisted results of adapters this run never queried are carried over.
+  std::unordered_map<UINT, PendingAdapter> adapters = gPending;
+  for (const auto& [adapter, identity] : gIdentities) {
+    adapters[adapter].identity = identity;
+  }
+  for (const auto& [key, entry] : gEntries) {
+    const auto it = adapters.find(getAdapter(key));
+    if (it != adapters.end() && gIdentities.count(getAdapter(key)) && !dependsOnDisplayMode(key.command)) {
+      it->second.entries[key] = entry;
+    }
+  }
+
+  const auto cachePath = getCachePath();
+  dxvk::util::RtxFileSys::mkDirs(cachePath.parent_path());
+  FILE* pFile = nullptr;
+  if (fopen_s(&pFile, cachePath.string().c_str(), "wb") != 0 || pFile == nullptr) {
+    Logger::err(format_string("[QueryCache] Unable to write query cache to %s", cachePath.string().c_str()));
+    return;
+  }
+
+  const FileHeader header = makeHeader((uint32_t) adapters.size());
+  fwrite(&header, sizeof(header), 1, pFile);
+  size_t numEntries = 0;
+  for (const auto& [adapter, pending] : adapters) {
+    const uint32_t adapterIndex = adapter;
+    const uint32_t count = (uint32_t) pending.entries.size();
+    fwrite(&adapterIndex, sizeof(adapterIndex), 1, pFile);
+    fwrite(&pending.identity, sizeof(pending.identity), 1, pFile);
+    fwrite(&count, sizeof(count), 1, pFile);
+    for (const auto& [key, entry] : pending.entries) {
+      EntryHeader entryHeader;
+      entryHeader.command = key.command;
+      std::copy(key.args.begin(), key.args.end(), std::begin(entryHeader.args));
+      entryHeader.hresult = entry.hresult;
+      entryHeader.payloadSize = (uint32_t) entry.payload.size();
+      fwrite(&entryHeader, sizeof(entryHeader), 1, pFile);
+      if (!entry.payload.empty()) {
+        fwrite(entry.payload.data(), entry.payload.size(), 1, pFile);
+      }
+    }
+    numEntries += count;
+  }
+  fclose(pFile);
+  gDirty = false;
+
+  Logger::info(format_string("[QueryCache] %zu results written to %s", numEntries, cachePath.string().c_str()));
+}
@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+
+#include "util_commands.h"
+
+#include <d3d9.h>
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Process-wide memo table for the adapter, caps and format queries IDirect3D9
+// forwards to the server over the module channel. Results are keyed by the
+// command and its full argument tuple, with the adapter ordinal always being
+// the first argument. Results that depend on the current display mode are
+// dropped whenever the mode may have changed. All other results can be
+// persisted to disk and are reused by later runs once the adapter identifier,
+// the bridge version and the renderer binary are confirmed to be unchanged.
+class ModuleQueryCache {
+public:
+  static constexpr size_t kMaxArgs = 6;
+
+  struct Key {
+    Commands::D3D9Command command;
+    std::array<uint32_t, kMaxArgs> args;
+
+    bool operator==(const Key& other) const {
+      return command == other.command && args == other.args;
+    }
+  };
+
+  template<typename... Args>
+  static Key makeKey(const Commands::D3D9Command command, const Args... args) {
+    static_assert(sizeof...(Args) >= 1 && sizeof...(Args) <= kMaxArgs, "Unsupported number of query arguments");
+    static_assert(((sizeof(Args) == sizeof(uint32_t)) && ...), "Query arguments must be 32-bit values");
+    Key key { command, {} };
+    size_t i = 0;
+    ((memcpy(&key.args[i++], &args, sizeof(uint32_t))), ...);
+    return key;
+  }
+
+  // Returns true and fills in the cached result if the query was seen before
+  static bool find(const Key& key, HRESULT& hresult, void* pData = nullptr, const size_t dataSize = 0);
+  template<typename T>
+  static bool find(const Key& key, HRESULT& hresult, T& data) {
+    return find(key, hresult, &data, sizeof(T));
+  }
+
+  static void store(const Key& key, const HRESULT hresult, const void* pData = nullptr, const size_t dataSize = 0);
+  template<typename T>
+  static void store(const Key& key, const HRESULT hresult, const T& data) {
+    store(key, hresult, &data, sizeof(T));
+  }
+
+  // Persisted results for an adapter are only used once its live identifier
+  // has been fetched from the server and matched against the stored one. The
+  // identifier is also what newly stored results are persisted under.
+  // needsValidation() returns true if the caller should fetch it now.
+  static bool needsValidation(const UINT adapter);
+  static void validateAdapter(const UINT adapter, const D3DADAPTER_IDENTIFIER9& identifier);
+
+  // Drops all results that depend on the current display mode
+  static void invalidateDisplayModes(const char* reason);
+
+  // Writes the persistable results to disk if anything changed since the last save
+  static void save();
+};
@@ -0,0 +1,180 @@
+/*
+ * Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#include "pch.h"
+#include "present_pacer.h"
+
+#include "config/global_options.h"
+#include "log/log.h"
+#include "util_devicecommand.h"
+#include "util_metrics.h"
+#include "util_profiling.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace {
+  using Clock = std::chrono::steady_clock;
+
+  // Frames per adjustment window
+  constexpr uint32_t kWindowFrames = 60;
+  // Raise the lead when the server sat idle in more than this many frames of a window
+  constexpr uint32_t kMaxStarvedFrames = kWindowFrames / 20;
+  // Only try lowering the lead when the client was held back in this many frames of a window
+  constexpr uint32_t kMinThrottledFrames = kWindowFrames * 9 / 10;
+  // Upper bound on the number of windows to wait before probing a lower lead again
+  constexpr uint32_t kMaxProbeBackoff = 32;
+
+  struct State {
+    bool initialized = false;
+    uint32_t allowedLead = 0;
+    uint32_t maxLead = 0;
+    Clock::time_point lastPresent;
+    bool throttledLastFrame = false;
+
+    // Current window
+    uint32_t frames = 0;
+    uint32_t starvedFrames = 0;
+    uint32_t throttledFrames = 0;
+    uint64_t frameTimeUs = 0;
+    uint64_t waitTimeUs = 0;
+    uint64_t queueFill = 0;
+
+    // Windows to skip before trying a lower lead, doubled every time a lower
+    // lead turns out to starve the server
+    uint32_t probeBackoff = 1;
+    uint32_t windowsSinceChange = 0;
+    uint32_t windowsSinceLower = kMaxProbeBackoff;
+  } gState;
+
+  uint32_t getFramesInFlight() {
+    const uint32_t clientFrames = DeviceBridge::getWriterChannel().writerFrameCount->load(std::memory_order_relaxed);
+    const uint32_t serverFrames = DeviceBridge::getReaderChannel().writerFrameCount->load(std::memory_order_acquire);
+    return clientFrames - serverFrames;
+  }
+
+  void setAllowedLead(const uint32_t lead, const char* reason) {
+    auto& s = gState;
+    Logger::info(format_string(
+      "[PresentPacer] Allowed lead %u -> %u frames (%s). Window: %u frames, avg frame %.2f ms, "
+      "avg wait %.2f ms, avg command queue fill %llu, starved %u, throttled %u",
+      s.allowedLead, lead, reason, s.frames, s.frameTimeUs / 1000.0 / s.frames, s.waitTimeUs / 1000.0 / s.frames,
+      s.queueFill / s.frames, s.starvedFrames, s.throttledFrames));
+    s.allowedLead = lead;
+  }
+
+  void adjustLead() {
+    auto& s = gState;
+    ++s.windowsSinceChange;
+    ++s.windowsSinceLower;
+    if (s.starvedFrames > kMaxStarvedFrames && s.allowedLead < s.maxLead) {
+      // The client was held back while the server ran out of work. If this
+      // follows a recent attempt at a lower lead, wait longer before the next one.
+      if (s.windowsSinceLower <= 2) {
+        s.probeBackoff = std::min(s.probeBackoff * 2, kMaxProbeBackoff);
+      }
+      s.windowsSinceChange = 0;
+      setAllowedLead(s.allowedLead + 1, "server starved");
+    } else if (s.starvedFrames == 0 && s.throttledFrames >= kMinThrottledFrames &&
+               s.allowedLead > 0 && s.windowsSinceChange > s.probeBackoff) {
+      // The server never ran dry and the client kept waiting on it, so every
+      // frame of lead beyond what is needed only adds input latency
+      s.windowsSinceChange = 0;
+      s.windowsSinceLower = 0;
+      setAllowedLead(s.allowedLead - 1, "server saturated");
+    } else if (s.throttledFrames == 0) {
+      // Client bound, the lead makes no difference until the server becomes
+      // the bottleneck again, so start probing from scratch then
+      s.probeBackoff = 1;
+    }
+    s.frames = 0;
+    s.starvedFrames = 0;
+    s.throttledFrames = 0;
+    s.frameTimeUs = 0;
+    s.waitTimeUs = 0;
+    s.queueFill = 0;
+  }
+}
+
+HRESULT PresentPacer::onPresent(bridge_util::NamedSemaphore& presentSemaphore) {
+  ZoneScoped;
+  auto& s = gState;
+  const auto start = Clock::now();
+  if (!s.initialized) {
+    s.maxLead = GlobalOptions::getPresentSemaphoreMaxFrames();
+    s.allowedLead = std::min(1u, s.maxLead);
+    s.lastPresent = start;
+    s.initialized = true;
+    Logger::info(format_string("[PresentPacer] Adaptive present pacing enabled, lead between 0 and %u frames.", s.maxLead));
+  }
+
+  // The frame just submitted is always in flight, so one frame in flight
+  // means the server has already finished every earlier frame. If the client
+  // was held back last frame that idle time was caused by pacing.
+  const uint32_t inFlight = getFramesInFlight();
+  const bool starved = inFlight <= 1 && s.throttledLastFrame;
+#ifndef USE_BLOCKING_QUEUE
+  s.queueFill += DeviceBridge::getWriterChannel().commands->getOccupancy();
+#endif
+
+  // The server releases the semaphore once per Present it processes, which
+  // makes it a wakeup signal here. Stale releases from frames where the
+  // client did not need to wait only cause an extra loop iteration.
+  const auto maxRetries = GlobalOptions::getCommandRetries();
+  size_t numRetries = 0;
+  bool throttled = false;
+  while (gbBridgeRunning && getFramesInFlight() > s.allowedLead) {
+    throttled = true;
+    const auto result = presentSemaphore.wait();
+    if (RESULT_FAILURE(result) && numRetries++ >= maxRetries) {
+      Logger::err("[PresentPacer] Max retries reached waiting on the server to present!");
+      return ERROR_SEM_TIMEOUT;
+    }
+  }
+  if (!gbBridgeRunning) {
+    Logger::err("Bridge was disabled while waiting on the Present semaphore, aborting current operation!");
+    return ERROR_OPERATION_ABORTED;
+  }
+
+  const auto end = Clock::now();
+  const uint64_t waitUs = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+  const uint64_t frameUs = std::chrono::duration_cast<std::chrono::microseconds>(end - s.lastPresent).count();
+  s.lastPresent = end;
+  s.throttledLastFrame = throttled;
+
+  ++s.frames;
+  s.starvedFrames += starved ? 1 : 0;
+  s.throttledFrames += throttled ? 1 : 0;
+  s.frameTimeUs += frameUs;
+  s.waitTimeUs += waitUs;
+  if (s.frames == kWindowFrames) {
+    adjustLead();
+  }
+
+  Metrics::addPresentWait(waitUs);
+  Metrics::setPresentPacing(s.allowedLead, inFlight);
+  TracyPlot(PlotNames::AllowedLead, (int64_t) s.allowedLead);
+  return S_OK;
+}
+
+uint32_t PresentPacer::getAllowedLead() {
+  return gState.allowedLead;
+}
@@ -0,0 +1,40 @@
+/*
+ * Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+
+#include "util_semaphore.h"
+
+#include <windows.h>
+
+// Adaptive replacement for the fixed presentSemaphoreMaxFrames lead. Every
+// Present the pacer measures the client frame time, the time spent waiting
+// on the server, the number of frames in flight and the command queue fill,
+// and every window of frames adjusts how many frames the client may be
+// ahead of the server. It aims for the lowest lead that does not leave the
+// server idle while the client is being held back.
+class PresentPacer {
+public:
+  // Waits until the number of frames in flight is within the allowed lead
+  static HRESULT onPresent(bridge_util::NamedSemaphore& presentSemaphore);
+
+  static uint32_t getAllowedLead();
+};
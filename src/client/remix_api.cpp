@@ -20,10 +20,16 @@
  * DEALINGS IN THE SOFTWARE.
  */
 
+#include "client_options.h"
 #include "log/log.h"
 #include "util_bridgecommand.h"
 #include "util_devicecommand.h"
 #include "util_remixapi.h"
+#include "util_sharedheap.h"
+#include "config/global_options.h"
+
+#include <mutex>
+#include <vector>
 
 using namespace remixapi::util;
 
@@ -62,6 +68,10 @@ inline void sendHandle(ClientMessage& msg, const Handle<RemixApiHandleT>& handle
   msg.send_data(handle.uid);
 }
 
+inline void logWarn(ClientMessage&, const char* const msg) {
+  Logger::warn(msg);
+}
+
 template<>
 inline void send(ClientMessage& msg, const Bool& b) {
   uint32_t boolVal = 0x0;
@@ -69,15 +79,222 @@ inline void send(ClientMessage& msg, const Bool& b) {
   msg.send_data(boolVal);
 }
 
+// SharedHeap::allocate() and deallocate() are commands of their own, so
+// they may not be called while a ClientMessage is open. Payloads large
+// enough for the heap are therefore staged by running the message body
+// against this scope first: every serializeAndSend() allocates and fills
+// its heap copy here, and the real message then only sends the allocation
+// ids, in the same order. Allocations are released when the scope is
+// destroyed, so declare it before the ClientMessage.
+class HeapPayloadScope {
+public:
+  template<typename SendFn>
+  HeapPayloadScope(const SendFn& sendFn)
+    : m_pPrev(s_pCurrent) {
+    s_pCurrent = this;
+    if (heapThreshold() > 0) {
+      sendFn(*this);
+    }
+  }
+  HeapPayloadScope(const HeapPayloadScope&) = delete;
+  HeapPayloadScope& operator=(const HeapPayloadScope&) = delete;
+
+  ~HeapPayloadScope() {
+    s_pCurrent = m_pPrev;
+    for (const auto id : m_ids) {
+      if (id != SharedHeap::kInvalidId) {
+        SharedHeap::deallocate(id);
+      }
+    }
+  }
+
+  template<typename SerializableT>
+  void stage(const SerializableT& serializable) {
+    if (!isHeapPayload(serializable.size())) {
+      return;
+    }
+    // An invalid id is kept as well so that staged ids pair up with the
+    // payloads of the second pass, which then falls back to the data queue
+    const auto allocId = SharedHeap::allocate(serializable.size());
+    if (allocId != SharedHeap::kInvalidId) {
+      serializable.serialize(SharedHeap::getBuf(allocId));
+    }
+    m_ids.push_back(allocId);
+  }
+
+  SharedHeap::AllocId take() {
+    assert(m_next < m_ids.size());
+    return (m_next < m_ids.size()) ? m_ids[m_next++] : SharedHeap::kInvalidId;
+  }
+
+  static bool isHeapPayload(const uint32_t size) {
+    const auto threshold = heapThreshold();
+    return threshold > 0 && size >= threshold;
+  }
+
+  static HeapPayloadScope* current() {
+    return s_pCurrent;
+  }
+
+private:
+  static uint32_t heapThreshold() {
+    static const uint32_t threshold =
+      GlobalOptions::getUseSharedHeap() ? ClientOptions::getRemixApiSharedHeapThreshold() : 0;
+    return threshold;
+  }
+
+  std::vector<SharedHeap::AllocId> m_ids;
+  size_t m_next = 0;
+  HeapPayloadScope* const m_pPrev;
+  static thread_local HeapPayloadScope* s_pCurrent;
+};
+thread_local HeapPayloadScope* HeapPayloadScope::s_pCurrent = nullptr;
+
+// Staging pass: only serialized payloads are of interest
+template<typename T>
+inline void send(HeapPayloadScope&, const T&) {
+}
+
+template<typename RemixApiHandleT>
+inline void sendHandle(HeapPayloadScope&, const Handle<RemixApiHandleT>&) {
+}
+
+// Logged once, by the pass sending the command
+inline void logWarn(HeapPayloadScope&, const char* const) {
+}
+
+template<typename SerializableT>
+void serializeAndSend(HeapPayloadScope& scope, const SerializableT& serializable) {
+  static_assert(is_serializable_v<SerializableT>, "serializeAndSend(...)  may only be called with defined Serializable<T> types");
+  scope.stage(serializable);
+}
+
+// Sends a payload staged in the SharedHeap by the current HeapPayloadScope
+// when large enough, or serializes it into a blob reserved in the data
+// queue otherwise. A heap payload is sent as an empty data packet followed
+// by the allocation id, a serialized struct is never empty since it always
+// carries its size.
 template<typename SerializableT>
-auto serializeAndSend(ClientMessage& msg, const SerializableT& serializable) {
+void serializeAndSend(ClientMessage& msg, const SerializableT& serializable) {
   static_assert(is_serializable_v<SerializableT>, "serializeAndSend(...)  may only be called with defined Serializable<T> types");
   msg.send_data(ToRemixApiStructEnum<SerializableT::BaseT>);
   const auto serializableSize = serializable.size();
-  auto pSlzd = new uint8_t[serializableSize];
-  serializable.serialize(pSlzd);
-  msg.send_data(serializableSize, pSlzd);
-  delete pSlzd;
+  if (HeapPayloadScope::isHeapPayload(serializableSize) && HeapPayloadScope::current()) {
+    const auto allocId = HeapPayloadScope::current()->take();
+    if (allocId != SharedHeap::kInvalidId) {
+      msg.send_data(0, nullptr);
+      msg.send_data(allocId);
+      return;
+    }
+  }
+  if (auto* const pSlzd = msg.begin_data_blob(serializableSize)) {
+    serializable.serialize(pSlzd);
+    msg.end_data_blob();
+  }
+}
+
+template<typename SerializableT>
+void serializeAppend(std::vector<uint8_t>& blob, const SerializableT& serializable) {
+  static_assert(is_serializable_v<SerializableT>, "serializeAppend(...)  may only be called with defined Serializable<T> types");
+  const uint32_t sType = ToRemixApiStructEnum<SerializableT::BaseT>;
+  const auto pos = blob.size();
+  blob.resize(pos + sizeof(sType) + serializable.size());
+  memcpy(&blob[pos], &sType, sizeof(sType));
+  serializable.serialize(&blob[pos + sizeof(sType)]);
+}
+
+// Collects DrawInstance calls into a single RemixApi_DrawInstanceBatch, see
+// remixapi::batch for the layout. The batch is sent when it is full, before
+// any other Remix API command so that e.g. a mesh is never destroyed before
+// an earlier draw of it, and at Present.
+class InstanceBatch {
+public:
+  static constexpr uint32_t kMaxInstances = 256;
+  static constexpr size_t kMaxExtensionBytes = 64 * 1024;
+
+  static void add(const remixapi_InstanceInfo& info) {
+    std::scoped_lock lock(s_mutex);
+    s_categoryFlags.push_back(info.categoryFlags);
+    s_meshes.push_back((uint32_t) (uintptr_t) info.mesh);
+    s_transforms.push_back(info.transform);
+    s_doubleSided.push_back(info.doubleSided);
+
+    if (getPNext(&info) == nullptr) {
+      s_extensionOffsets.push_back(batch::kNoExtensions);
+    } else {
+      s_extensionOffsets.push_back((uint32_t) s_extensions.size());
+      const void* infoItr = &info;
+      while (auto* const pNext = getPNext(infoItr)) {
+        infoItr = pNext;
+        switch (getSType(pNext)) {
+          case REMIXAPI_STRUCT_TYPE_INSTANCE_INFO_OBJECT_PICKING_EXT:
+            serializeAppend(s_extensions, serialize::InstanceInfoObjectPicking(
+              *static_cast<const remixapi_InstanceInfoObjectPickingEXT* const>(infoItr)));
+            break;
+          case REMIXAPI_STRUCT_TYPE_INSTANCE_INFO_BLEND_EXT:
+            serializeAppend(s_extensions, serialize::InstanceInfoBlend(
+              *static_cast<const remixapi_InstanceInfoBlendEXT* const>(infoItr)));
+            break;
+          case REMIXAPI_STRUCT_TYPE_INSTANCE_INFO_BONE_TRANSFORMS_EXT:
+            serializeAppend(s_extensions, serialize::InstanceInfoTransforms(
+              *static_cast<const remixapi_InstanceInfoBoneTransformsEXT* const>(infoItr)));
+            break;
+          default:
+            Logger::warn("[remixapi_DrawInstance] Unknown sType. Skipping.");
+            break;
+        }
+      }
+      const uint32_t terminator = REMIXAPI_STRUCT_TYPE_NONE;
+      const auto pos = s_extensions.size();
+      s_extensions.resize(pos + sizeof(terminator));
+      memcpy(&s_extensions[pos], &terminator, sizeof(terminator));
+    }
+
+    if (s_meshes.size() >= kMaxInstances || s_extensions.size() >= kMaxExtensionBytes) {
+      flushLocked();
+    }
+  }
+
+  static void flush() {
+    std::scoped_lock lock(s_mutex);
+    flushLocked();
+  }
+
+private:
+  static void flushLocked() {
+    const uint32_t count = (uint32_t) s_meshes.size();
+    if (count == 0) {
+      return;
+    }
+    {
+      ClientMessage c(Commands::RemixApi_DrawInstanceBatch);
+      c.send_data(count);
+      c.send_data(count * sizeof(uint32_t), s_categoryFlags.data());
+      c.send_data(count * sizeof(uint32_t), s_meshes.data());
+      c.send_data(count * sizeof(remixapi_Transform), s_transforms.data());
+      c.send_data(count * sizeof(uint32_t), s_doubleSided.data());
+      c.send_data(count * sizeof(uint32_t), s_extensionOffsets.data());
+      c.send_data((uint32_t) s_extensions.size(), s_extensions.empty() ? nullptr : s_extensions.data());
+    }
+    s_categoryFlags.clear();
+    s_meshes.clear();
+    s_transforms.clear();
+    s_doubleSided.clear();
+    s_extensionOffsets.clear();
+    s_extensions.clear();
+  }
+
+  static inline std::mutex s_mutex;
+  static inline std::vector<uint32_t> s_categoryFlags;
+  static inline std::vector<uint32_t> s_meshes;
+  static inline std::vector<remixapi_Transform> s_transforms;
+  static inline std::vector<uint32_t> s_doubleSided;
+  static inline std::vector<uint32_t> s_extensionOffsets;
+  static inline std::vector<uint8_t> s_extensions;
+};
+
+void flushInstanceBatch() {
+  InstanceBatch::flush();
 }
 
 
@@ -86,61 +303,65 @@ remixapi_ErrorCode REMIXAPI_CALL remixapi_CreateMaterial(
   remixapi_MaterialHandle*     out_handle) {
 
   ASSERT_REMIXAPI_PFN_TYPE(remixapi_CreateMaterial);
+  InstanceBatch::flush();
   assert(info->sType == REMIXAPI_STRUCT_TYPE_MATERIAL_INFO);
 
   MaterialHandle newHandle;
   {
-    ClientMessage c(Commands::RemixApi_CreateMaterial);
-
-    serializeAndSend<serialize::MaterialInfo>(c, *info);
-
-    // For each valid pNext, we will send a true-valued bool to indicate that
-    // server must read another extension. If it reads false, it knows that it
-    // is done reading.
-    // send(c, Bool::True); -> CONTINUE
-    // send(c, Bool::False); -> STOP
-    const void* infoItr = info;
-    while (auto* const pNext = getPNext(infoItr)) {
-      infoItr = pNext;
-      switch (getSType(pNext)) {
-        case REMIXAPI_STRUCT_TYPE_MATERIAL_INFO_OPAQUE_EXT:
-        {
-          auto* pOpaqueMat = static_cast<const remixapi_MaterialInfoOpaqueEXT* const>(infoItr);
-          send(c, Bool::True); 
-          serializeAndSend<serialize::MaterialInfoOpaque>(c, *pOpaqueMat);
-          break;
-        }
-        case REMIXAPI_STRUCT_TYPE_MATERIAL_INFO_OPAQUE_SUBSURFACE_EXT:
-        {
-          auto* pOpaqueSubsurfaceMat = static_cast<const remixapi_MaterialInfoOpaqueSubsurfaceEXT* const>(infoItr);
-          send(c, Bool::True);
-          serializeAndSend<serialize::MaterialInfoOpaqueSubsurface>(c, *pOpaqueSubsurfaceMat);
-          break;
-        }
-        case REMIXAPI_STRUCT_TYPE_MATERIAL_INFO_TRANSLUCENT_EXT:
-        {
-          auto* pTranslucentMat = static_cast<const remixapi_MaterialInfoTranslucentEXT* const>(infoItr);
-          send(c, Bool::True);
-          serializeAndSend<serialize::MaterialInfoTranslucent>(c, *pTranslucentMat);
-          break;
-        }
-        case REMIXAPI_STRUCT_TYPE_MATERIAL_INFO_PORTAL_EXT:
-        {
-          auto* pPortalMat = static_cast<const remixapi_MaterialInfoPortalEXT* const>(infoItr);
-          send(c, Bool::True);
-          serializeAndSend<serialize::MaterialInfoPortal>(c, *pPortalMat);
-          break;
-        }
-        default:
-        {
-          Logger::warn("[remixapi_CreateMaterial] Unknown sType. Skipping.");
-          break;
+    const auto sendMaterial = [&](auto& c) {
+      serializeAndSend<serialize::MaterialInfo>(c, *info);
+
+      // For each valid pNext, we will send a true-valued bool to indicate that
+      // server must read another extension. If it reads false, it knows that it
+      // is done reading.
+      // send(c, Bool::True); -> CONTINUE
+      // send(c, Bool::False); -> STOP
+      const void* infoItr = info;
+      while (auto* const pNext = getPNext(infoItr)) {
+        infoItr = pNext;
+        switch (getSType(pNext)) {
+          case REMIXAPI_STRUCT_TYPE_MATERIAL_INFO_OPAQUE_EXT:
+          {
+            auto* pOpaqueMat = static_cast<const remixapi_MaterialInfoOpaqueEXT* const>(infoItr);
+            send(c, Bool::True); 
+            serializeAndSend<serialize::MaterialInfoOpaque>(c, *pOpaqueMat);
+            break;
+          }
+          case REMIXAPI_STRUCT_TYPE_MATERIAL_INFO_OPAQUE_SUBSURFACE_EXT:
+          {
+            auto* pOpaqueSubsurfaceMat = static_cast<const remixapi_MaterialInfoOpaqueSubsurfaceEXT* const>(infoItr);
+            send(c, Bool::True);
+            serializeAndSend<serialize::MaterialInfoOpaqueSubsurface>(c, *pOpaqueSubsurfaceMat);
+            break;
+          }
+          case REMIXAPI_STRUCT_TYPE_MATERIAL_INFO_TRANSLUCENT_EXT:
+          {
+            auto* pTranslucentMat = static_cast<const remixapi_MaterialInfoTranslucentEXT* const>(infoItr);
+            send(c, Bool::True);
+            serializeAndSend<serialize::MaterialInfoTranslucent>(c, *pTranslucentMat);
+            break;
+          }
+          case REMIXAPI_STRUCT_TYPE_MATERIAL_INFO_PORTAL_EXT:
+          {
+            auto* pPortalMat = static_cast<const remixapi_MaterialInfoPortalEXT* const>(infoItr);
+            send(c, Bool::True);
+            serializeAndSend<serialize::MaterialInfoPortal>(c, *pPortalMat);
+            break;
+          }
+          default:
+          {
+            logWarn(c, "[remixapi_CreateMaterial] Unknown sType. Skipping.");
+            break;
+          }
         }
+        infoItr = pNext;
       }
-      infoItr = pNext;
-    }
-    send(c, Bool::False);
-    sendHandle(c, newHandle);
+      send(c, Bool::False);
+      sendHandle(c, newHandle);
+    };
+    HeapPayloadScope heapPayloads(sendMaterial);
+    ClientMessage c(Commands::RemixApi_CreateMaterial);
+    sendMaterial(c);
   }
 
   *out_handle = newHandle;
@@ -150,6 +371,7 @@ remixapi_ErrorCode REMIXAPI_CALL remixapi_CreateMaterial(
 
 remixapi_ErrorCode REMIXAPI_CALL remixapi_DestroyMaterial(remixapi_MaterialHandle handle) {
   ASSERT_REMIXAPI_PFN_TYPE(remixapi_DestroyMaterial);
+  InstanceBatch::flush();
   MaterialHandle materialHandle(handle);
   if(!materialHandle.isValid()) {
     return REMIXAPI_ERROR_CODE_INVALID_ARGUMENTS;
@@ -166,25 +388,29 @@ remixapi_ErrorCode REMIXAPI_CALL remixapi_CreateMesh(
   remixapi_MeshHandle*     out_handle) {
 
   ASSERT_REMIXAPI_PFN_TYPE(remixapi_CreateMesh);
+  InstanceBatch::flush();
   assert(info->sType == REMIXAPI_STRUCT_TYPE_MESH_INFO);
 
   MeshHandle newHandle;
   {
-    ClientMessage c(Commands::RemixApi_CreateMesh);
-    
-    serializeAndSend<serialize::MeshInfo>(c, *info);
-
-    const void* infoItr = info;
-    while (auto* const pNext = getPNext(infoItr)) {
-      switch (getSType(pNext)) {
-        default:
-        {
-          Logger::warn("[remixapi_CreateMesh] Unknown sType. Skipping.");
-          break;
+    const auto sendMesh = [&](auto& c) {
+      serializeAndSend<serialize::MeshInfo>(c, *info);
+
+      const void* infoItr = info;
+      while (auto* const pNext = getPNext(infoItr)) {
+        switch (getSType(pNext)) {
+          default:
+          {
+            logWarn(c, "[remixapi_CreateMesh] Unknown sType. Skipping.");
+            break;
+          }
         }
       }
-    }
-    sendHandle(c, newHandle);
+      sendHandle(c, newHandle);
+    };
+    HeapPayloadScope heapPayloads(sendMesh);
+    ClientMessage c(Commands::RemixApi_CreateMesh);
+    sendMesh(c);
   }
   
   *out_handle = newHandle;
@@ -194,6 +420,7 @@ remixapi_ErrorCode REMIXAPI_CALL remixapi_CreateMesh(
 
 remixapi_ErrorCode REMIXAPI_CALL remixapi_DestroyMesh(remixapi_MeshHandle handle) {
   ASSERT_REMIXAPI_PFN_TYPE(remixapi_DestroyMesh);
+  InstanceBatch::flush();
   MeshHandle meshHandle(handle);
   if(!meshHandle.isValid()) {
     return REMIXAPI_ERROR_CODE_INVALID_ARGUMENTS;
@@ -207,49 +434,56 @@ remixapi_ErrorCode REMIXAPI_CALL remixapi_DestroyMesh(remixapi_MeshHandle handle
 
 remixapi_ErrorCode REMIXAPI_CALL remixapi_DrawInstance(const remixapi_InstanceInfo* info) {
   ASSERT_REMIXAPI_PFN_TYPE(remixapi_DrawInstance);
+  if (ClientOptions::getRemixApiInstanceBatching()) {
+    InstanceBatch::add(*info);
+    return REMIXAPI_ERROR_CODE_SUCCESS;
+  }
   {
-    ClientMessage c(Commands::RemixApi_DrawInstance);
-
-    serializeAndSend<serialize::InstanceInfo>(c, *info);
-
-    // For each valid pNext, we will send a true-valued bool to indicate that
-    // server must read another extension. If it reads false, it knows that it
-    // is done reading.
-    // send(c, Bool::True); -> CONTINUE
-    // send(c, Bool::False); -> STOP
-    const void* infoItr = info;
-    while (auto* const pNext = getPNext(infoItr)) {
-      infoItr = pNext;
-      switch (getSType(pNext)) {
-        case REMIXAPI_STRUCT_TYPE_INSTANCE_INFO_OBJECT_PICKING_EXT:
-        {
-          auto* pObjectPicking = static_cast<const remixapi_InstanceInfoObjectPickingEXT* const>(infoItr);
-          send(c, Bool::True);
-          serializeAndSend<serialize::InstanceInfoObjectPicking>(c, *pObjectPicking);
-          break;
-        }
-        case REMIXAPI_STRUCT_TYPE_INSTANCE_INFO_BLEND_EXT:
-        {
-          auto* pBlend = static_cast<const remixapi_InstanceInfoBlendEXT* const>(infoItr);
-          send(c, Bool::True);
-          serializeAndSend<serialize::InstanceInfoBlend>(c, *pBlend);
-          break;
-        }
-        case REMIXAPI_STRUCT_TYPE_INSTANCE_INFO_BONE_TRANSFORMS_EXT:
-        {
-          auto* pXforms = static_cast<const remixapi_InstanceInfoBoneTransformsEXT* const>(infoItr);
-          send(c, Bool::True);
-          serializeAndSend<serialize::InstanceInfoTransforms>(c, *pXforms);
-          break;
-        }
-        default:
-        {
-          Logger::warn("[remixapi_DrawInstance] Unknown sType. Skipping.");
-          break;
+    const auto sendInstance = [&](auto& c) {
+      serializeAndSend<serialize::InstanceInfo>(c, *info);
+
+      // For each valid pNext, we will send a true-valued bool to indicate that
+      // server must read another extension. If it reads false, it knows that it
+      // is done reading.
+      // send(c, Bool::True); -> CONTINUE
+      // send(c, Bool::False); -> STOP
+      const void* infoItr = info;
+      while (auto* const pNext = getPNext(infoItr)) {
+        infoItr = pNext;
+        switch (getSType(pNext)) {
+          case REMIXAPI_STRUCT_TYPE_INSTANCE_INFO_OBJECT_PICKING_EXT:
+          {
+            auto* pObjectPicking = static_cast<const remixapi_InstanceInfoObjectPickingEXT* const>(infoItr);
+            send(c, Bool::True);
+            serializeAndSend<serialize::InstanceInfoObjectPicking>(c, *pObjectPicking);
+            break;
+          }
+          case REMIXAPI_STRUCT_TYPE_INSTANCE_INFO_BLEND_EXT:
+          {
+            auto* pBlend = static_cast<const remixapi_InstanceInfoBlendEXT* const>(infoItr);
+            send(c, Bool::True);
+            serializeAndSend<serialize::InstanceInfoBlend>(c, *pBlend);
+            break;
+          }
+          case REMIXAPI_STRUCT_TYPE_INSTANCE_INFO_BONE_TRANSFORMS_EXT:
+          {
+            auto* pXforms = static_cast<const remixapi_InstanceInfoBoneTransformsEXT* const>(infoItr);
+            send(c, Bool::True);
+            serializeAndSend<serialize::InstanceInfoTransforms>(c, *pXforms);
+            break;
+          }
+          default:
+          {
+            logWarn(c, "[remixapi_DrawInstance] Unknown sType. Skipping.");
+            break;
+          }
         }
       }
-    }
-    send(c, Bool::False);
+      send(c, Bool::False);
+    };
+    HeapPayloadScope heapPayloads(sendInstance);
+    ClientMessage c(Commands::RemixApi_DrawInstance);
+    sendInstance(c);
   }
   return REMIXAPI_ERROR_CODE_SUCCESS;
 }
@@ -259,81 +493,85 @@ remixapi_ErrorCode REMIXAPI_CALL remixapi_CreateLight(
   remixapi_LightHandle*     out_handle) {
     
   ASSERT_REMIXAPI_PFN_TYPE(remixapi_CreateLight);
+  InstanceBatch::flush();
   assert(info->sType == REMIXAPI_STRUCT_TYPE_LIGHT_INFO);
 
   LightHandle newHandle;
   {
-    ClientMessage c(Commands::RemixApi_CreateLight);
-
-    serializeAndSend<serialize::LightInfo>(c, *info);
-    
-    // For each valid pNext, we will send a true-valued bool to indicate that
-    // server must read another extension. If it reads false, it knows that it
-    // is done reading.
-    // send(c, Bool::True); -> CONTINUE
-    // send(c, Bool::False); -> STOP
-    const void* infoItr = info;
-    while (auto* const pNext = getPNext(infoItr)) {
-      infoItr = pNext;
-      switch (getSType(infoItr)) {
-        case REMIXAPI_STRUCT_TYPE_LIGHT_INFO_SPHERE_EXT:
-        {
-          auto* pSphere = static_cast<const remixapi_LightInfoSphereEXT* const>(infoItr);
-          send(c, Bool::True);
-          serializeAndSend<serialize::LightInfoSphere>(c, *pSphere);
-          break;
-        }
-        case REMIXAPI_STRUCT_TYPE_LIGHT_INFO_RECT_EXT:
-        {
-          auto* pRect = static_cast<const remixapi_LightInfoRectEXT* const>(infoItr);
-          send(c, Bool::True);
-          serializeAndSend<serialize::LightInfoRect>(c, *pRect);
-          break;
-        }
-        case REMIXAPI_STRUCT_TYPE_LIGHT_INFO_DISK_EXT:
-        {
-          auto* pDisk = static_cast<const remixapi_LightInfoDiskEXT* const>(infoItr);
-          send(c, Bool::True);
-          serializeAndSend<serialize::LightInfoDisk>(c, *pDisk);
-          break;
-        }
-        case REMIXAPI_STRUCT_TYPE_LIGHT_INFO_CYLINDER_EXT:
-        {
-          auto* pCylinder = static_cast<const remixapi_LightInfoCylinderEXT* const>(infoItr);
-          send(c, Bool::True);
-          serializeAndSend<serialize::LightInfoCylinder>(c, *pCylinder);
-          break;
-        }
-        case REMIXAPI_STRUCT_TYPE_LIGHT_INFO_DISTANT_EXT:
-        {
-          auto* pDistant = static_cast<const remixapi_LightInfoDistantEXT* const>(infoItr);
-          send(c, Bool::True);
-          serializeAndSend<serialize::LightInfoDistant>(c, *pDistant);
-          break;
-        }
-        case REMIXAPI_STRUCT_TYPE_LIGHT_INFO_DOME_EXT:
-        {
-          auto* pDome = static_cast<const remixapi_LightInfoDomeEXT* const>(infoItr);
-          send(c, Bool::True);
-          serializeAndSend<serialize::LightInfoDome>(c, *pDome);
-          break;
-        }
-        case REMIXAPI_STRUCT_TYPE_LIGHT_INFO_USD_EXT:
-        {
-          auto* pUSD = static_cast<const remixapi_LightInfoUSDEXT* const>(infoItr);
-          send(c, Bool::True);
-          serializeAndSend<serialize::LightInfoUSD>(c, *pUSD);
-          break;
-        }
-        default:
-        {
-          Logger::warn("[remixapi_CreateLight] Unknown sType. Skipping.");
-          break;
+    const auto sendLight = [&](auto& c) {
+      serializeAndSend<serialize::LightInfo>(c, *info);
+
+      // For each valid pNext, we will send a true-valued bool to indicate that
+      // server must read another extension. If it reads false, it knows that it
+      // is done reading.
+      // send(c, Bool::True); -> CONTINUE
+      // send(c, Bool::False); -> STOP
+      const void* infoItr = info;
+      while (auto* const pNext = getPNext(infoItr)) {
+        infoItr = pNext;
+        switch (getSType(infoItr)) {
+          case REMIXAPI_STRUCT_TYPE_LIGHT_INFO_SPHERE_EXT:
+          {
+            auto* pSphere = static_cast<const remixapi_LightInfoSphereEXT* const>(infoItr);
+            send(c, Bool::True);
+            serializeAndSend<serialize::LightInfoSphere>(c, *pSphere);
+            break;
+          }
+          case REMIXAPI_STRUCT_TYPE_LIGHT_INFO_RECT_EXT:
+          {
+            auto* pRect = static_cast<const remixapi_LightInfoRectEXT* const>(infoItr);
+            send(c, Bool::True);
+            serializeAndSend<serialize::LightInfoRect>(c, *pRect);
+            break;
+          }
+          case REMIXAPI_STRUCT_TYPE_LIGHT_INFO_DISK_EXT:
+          {
+            auto* pDisk = static_cast<const remixapi_LightInfoDiskEXT* const>(infoItr);
+            send(c, Bool::True);
+            serializeAndSend<serialize::LightInfoDisk>(c, *pDisk);
+            break;
+          }
+          case REMIXAPI_STRUCT_TYPE_LIGHT_INFO_CYLINDER_EXT:
+          {
+            auto* pCylinder = static_cast<const remixapi_LightInfoCylinderEXT* const>(infoItr);
+            send(c, Bool::True);
+            serializeAndSend<serialize::LightInfoCylinder>(c, *pCylinder);
+            break;
+          }
+          case REMIXAPI_STRUCT_TYPE_LIGHT_INFO_DISTANT_EXT:
+          {
+            auto* pDistant = static_cast<const remixapi_LightInfoDistantEXT* const>(infoItr);
+            send(c, Bool::True);
+            serializeAndSend<serialize::LightInfoDistant>(c, *pDistant);
+            break;
+          }
+          case REMIXAPI_STRUCT_TYPE_LIGHT_INFO_DOME_EXT:
+          {
+            auto* pDome = static_cast<const remixapi_LightInfoDomeEXT* const>(infoItr);
+            send(c, Bool::True);
+            serializeAndSend<serialize::LightInfoDome>(c, *pDome);
+            break;
+          }
+          case REMIXAPI_STRUCT_TYPE_LIGHT_INFO_USD_EXT:
+          {
+            auto* pUSD = static_cast<const remixapi_LightInfoUSDEXT* const>(infoItr);
+            send(c, Bool::True);
+            serializeAndSend<serialize::LightInfoUSD>(c, *pUSD);
+            break;
+          }
+          default:
+          {
+            logWarn(c, "[remixapi_CreateLight] Unknown sType. Skipping.");
+            break;
+          }
         }
       }
-    }
-    send(c, Bool::False);
-    sendHandle(c, newHandle);
+      send(c, Bool::False);
+      sendHandle(c, newHandle);
+    };
+    HeapPayloadScope heapPayloads(sendLight);
+    ClientMessage c(Commands::RemixApi_CreateLight);
+    sendLight(c);
   }
 
   *out_handle = newHandle;
@@ -343,6 +581,7 @@ remixapi_ErrorCode REMIXAPI_CALL remixapi_CreateLight(
 
 remixapi_ErrorCode REMIXAPI_CALL remixapi_DestroyLight(remixapi_LightHandle handle) {
   ASSERT_REMIXAPI_PFN_TYPE(remixapi_DestroyLight);
+  InstanceBatch::flush();
   LightHandle lightHandle(handle);
   if(!lightHandle.isValid()) {
     return REMIXAPI_ERROR_CODE_INVALID_ARGUMENTS;
@@ -356,6 +595,7 @@ remixapi_ErrorCode REMIXAPI_CALL remixapi_DestroyLight(remixapi_LightHandle hand
 
 remixapi_ErrorCode REMIXAPI_CALL remixapi_DrawLightInstance(remixapi_LightHandle handle) {
   ASSERT_REMIXAPI_PFN_TYPE(remixapi_DrawLightInstance);
+  InstanceBatch::flush();
   LightHandle lightHandle(handle);
   if(!lightHandle.isValid()) {
     return REMIXAPI_ERROR_CODE_INVALID_ARGUMENTS;
@@ -369,6 +609,7 @@ remixapi_ErrorCode REMIXAPI_CALL remixapi_DrawLightInstance(remixapi_LightHandle
 
 remixapi_ErrorCode REMIXAPI_CALL remixapi_SetConfigVariable(const char* var, const char* value) {
   ASSERT_REMIXAPI_PFN_TYPE(remixapi_SetConfigVariable);
+  InstanceBatch::flush();
   if (!var || !value) {
     return REMIXAPI_ERROR_CODE_INVALID_ARGUMENTS;
   }
@@ -30,4 +30,7 @@ extern PFN_remixapi_BridgeCallback g_beginSceneCallback;
 extern PFN_remixapi_BridgeCallback g_endSceneCallback;
 extern PFN_remixapi_BridgeCallback g_presentCallback;
 
+// Sends any DrawInstance calls still held back for batching
+void flushInstanceBatch();
+
 }
@@ -21,24 +21,107 @@
  */
 #pragma once
 
+#include "util_handletable.h"
+
 #include <unknwn.h>
-#include <unordered_map>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
 
-using ShadowMap = std::unordered_map<uintptr_t, IUnknown*>;
-extern ShadowMap gShadowMap;
-extern std::mutex gShadowMapMutex;
+// Maps client object ids to their wrapper objects. Ids are dense slot indices
+// (see bridge_util::Handle), so the map is a flat table of atomic slots split into
+// lazily allocated pages. Lookups never take a lock, inserts and erases only touch
+// their own slot, and publishing a new page is the only write threads race on.
+class ShadowMap {
+  struct Slot {
+    std::atomic<uint32_t> id = 0;
+    std::atomic<IUnknown*> obj = nullptr;
+  };
+
+  static constexpr uint32_t kPageBits = 12;
+  static constexpr uint32_t kPageSize = 1u << kPageBits;
+  static constexpr uint32_t kPageMask = kPageSize - 1;
+  static constexpr uint32_t kNumPages = bridge_util::Handle::kMaxIndices / kPageSize;
+
+  std::array<std::atomic<Slot*>, kNumPages> m_pages = {};
+  // Number of updates that raced with another thread's update
+  std::atomic<size_t> m_contention = 0;
+
+  Slot* findSlot(const uintptr_t id) const {
+    const uint32_t idx = bridge_util::Handle::index((uint32_t) id);
+    Slot* const pPage = m_pages[idx >> kPageBits].load(std::memory_order_acquire);
+    return pPage ? &pPage[idx & kPageMask] : nullptr;
+  }
 
-#define SHADOW_MAP_LOCKGUARD \
-   std::scoped_lock lockObj(gShadowMapMutex); \
+  Slot& getSlot(const uintptr_t id) {
+    const uint32_t idx = bridge_util::Handle::index((uint32_t) id);
+    auto& page = m_pages[idx >> kPageBits];
+    Slot* pPage = page.load(std::memory_order_acquire);
+    if (pPage == nullptr) {
+      Slot* const pNewPage = new Slot[kPageSize];
+      if (page.compare_exchange_strong(pPage, pNewPage, std::memory_order_acq_rel)) {
+        pPage = pNewPage;
+      } else {
+        // Another thread published the page first, pPage now points to it
+        delete[] pNewPage;
+        ++m_contention;
+      }
+    }
+    return pPage[idx & kPageMask];
+  }
+
+public:
+  ~ShadowMap() {
+    for (auto& page : m_pages) {
+      delete[] page.load();
+    }
+  }
+
+  void insert(const uintptr_t id, IUnknown* const pObj) {
+    Slot& slot = getSlot(id);
+    // Unpublish the slot while the object is written so readers never pair the
+    // new id with a stale object
+    slot.id.store(0, std::memory_order_release);
+    slot.obj.store(pObj, std::memory_order_release);
+    slot.id.store((uint32_t) id, std::memory_order_release);
+  }
+
+  void erase(const uintptr_t id) {
+    Slot* const pSlot = findSlot(id);
+    if (pSlot == nullptr) {
+      return;
+    }
+    uint32_t expected = (uint32_t) id;
+    if (pSlot->id.compare_exchange_strong(expected, 0, std::memory_order_acq_rel)) {
+      pSlot->obj.store(nullptr, std::memory_order_release);
+    } else if (expected != 0) {
+      // The slot was already taken over by a newer object
+      ++m_contention;
+    }
+  }
+
+  IUnknown* find(const uintptr_t id) const {
+    const Slot* const pSlot = findSlot(id);
+    if (pSlot == nullptr || pSlot->id.load(std::memory_order_acquire) != (uint32_t) id) {
+      return nullptr;
+    }
+    IUnknown* const pObj = pSlot->obj.load(std::memory_order_acquire);
+    // Re-check the id in case the slot was updated while reading the object
+    return pSlot->id.load(std::memory_order_acquire) == (uint32_t) id ? pObj : nullptr;
+  }
+
+  size_t getContentionCount() const {
+    return m_contention.load(std::memory_order_relaxed);
+  }
+};
+
+extern ShadowMap gShadowMap;
 
 class BaseDirect3DDevice9Ex_LSS;
 
 template<class WrapperType>
 static WrapperType* trackWrapper(WrapperType* const pLss) {
-  {
-    SHADOW_MAP_LOCKGUARD;
-    gShadowMap[pLss->getId()] = pLss;
-  }
-
+  gShadowMap.insert(pLss->getId(), pLss);
   return pLss;
-}
\ No newline at end of file
+}
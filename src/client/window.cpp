@@ -25,11 +25,13 @@
 #include "detours_common.h"
 #include "di_hook.h"
 #include "message_channels.h"
+#include "module_query_cache.h"
 #include "remix_state.h"
 #include "swapchain_map.h"
 
 #include "log/log.h"
 
+#include "util_inputring.h"
 #include "util_monitor.h"
 
 #include <unordered_map>
@@ -268,9 +270,20 @@ bool remixMsg(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam) {
   // on Remix renderer side.
   const bool doForward = msg != WM_INPUT;
 
-  // Forward to remix renderer
+  // Forward to remix renderer, input goes through the shared memory ring when possible.
+  // Other messages only queue up behind input still pending in the ring, so that
+  // neither one overtakes the other.
   if (doForward) {
-    gpRemixMessageChannel->send(msg, wParam, lParam);
+    bool bQueued = false;
+    if (gpRemixMessageChannel->canSend()) {
+      const uint32_t threadId = gpRemixMessageChannel->getServerThreadId();
+      bQueued = isInputMessage(msg) ?
+        InputRing::push(threadId, msg, wParam, lParam) :
+        InputRing::pushBehindPending(threadId, msg, wParam, lParam);
+    }
+    if (!bQueued) {
+      gpRemixMessageChannel->send(msg, wParam, lParam);
+    }
   }
 
   // Block the input message when Remix UI is active
@@ -292,6 +305,9 @@ LRESULT WINAPI RemixWndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam) {
   if (msg == WM_ACTIVATEAPP || msg == WM_SIZE || msg == WM_DESTROY) {
     windowMsg(hWnd, msg, wParam, lParam);
   }
+  if (msg == WM_DISPLAYCHANGE) {
+    ModuleQueryCache::invalidateDisplayModes("display change");
+  }
   const bool bSwallowMsg = remixMsg(hWnd, msg, wParam, lParam);
   if (bSwallowMsg) {
     lresult = !isUnicode ? DefWindowProcA(hWnd, msg, wParam, lParam) :
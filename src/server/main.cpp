@@ -23,8 +23,15 @@
 
 #include "version.h"
 #include "module_processing.h"
+#include "shader_cache.h"
+#include "upload_pool.h"
 #include "remix_api.h"
 
+#include "util_apitrace.h"
+#include "util_inputring.h"
+#include "util_queryresults.h"
+#include "util_metrics.h"
+#include "util_profiling.h"
 #include "util_bridge_assert.h"
 #include "util_circularbuffer.h"
 #include "util_commands.h"
@@ -32,7 +39,9 @@
 #include "util_devicecommand.h"
 #include "util_filesys.h"
 #include "util_guid.h"
+#include "util_handletable.h"
 #include "util_hack_d3d_debug.h"
+#include "util_memcpy.h"
 #include "util_messagechannel.h"
 #include "util_modulecommand.h"
 #include "util_process.h"
@@ -57,6 +66,7 @@
 #include <map>
 #include <atomic>
 #include <array>
+#include <algorithm>
 
 using namespace Commands;
 using namespace bridge_util;
@@ -124,19 +134,23 @@ LPDIRECT3D9 gpD3D;
 bool gOverwriteConditionAlreadyActive = false;
 
 // Mapping between client and server pointer addresses
-std::unordered_map<uint32_t, IDirect3DDevice9*> gpD3DDevices;
-std::unordered_map<uint32_t, IDirect3DResource9*> gpD3DResources; // For Textures, Buffers, and Surfaces
-std::unordered_map<uint32_t, IDirect3DVolume9*> gpD3DVolumes;
-std::unordered_map<uint32_t, IDirect3DVertexDeclaration9*> gpD3DVertexDeclarations;
-std::unordered_map<uint32_t, IDirect3DStateBlock9*> gpD3DStateBlocks;
-std::unordered_map<uint32_t, IDirect3DVertexShader9*> gpD3DVertexShaders;
-std::unordered_map<uint32_t, IDirect3DPixelShader9*> gpD3DPixelShaders;
-std::unordered_map<uint32_t, IDirect3DSwapChain9*> gpD3DSwapChains;
-std::unordered_map<uint32_t, IDirect3DQuery9*> gpD3DQuery;
+HandleTable<IDirect3DDevice9*> gpD3DDevices;
+HandleTable<IDirect3DResource9*> gpD3DResources; // For Textures, Buffers, and Surfaces
+HandleTable<IDirect3DVolume9*> gpD3DVolumes;
+HandleTable<IDirect3DVertexDeclaration9*> gpD3DVertexDeclarations;
+HandleTable<IDirect3DStateBlock9*> gpD3DStateBlocks;
+HandleTable<IDirect3DVertexShader9*> gpD3DVertexShaders;
+HandleTable<IDirect3DPixelShader9*> gpD3DPixelShaders;
+HandleTable<IDirect3DSwapChain9*> gpD3DSwapChains;
+HandleTable<IDirect3DQuery9*> gpD3DQuery;
 std::unordered_map<uint32_t, void*> gMapRemixApi;
+// Vertex declarations the runtime derived from FVF codes, per device
+std::unordered_map<IDirect3DDevice9*, std::unordered_map<DWORD, IDirect3DVertexDeclaration9*>> gFvfDeclarations;
 
 // Global state
 bool gbBridgeRunning = true;
+std::unique_ptr<UploadPool> gpUploadPool;
+ShaderCache gShaderCache;
 HANDLE hWait;
 
 namespace {
@@ -145,11 +159,27 @@ static void deserializeFromQueue(SerializableT& serializableT) {
   static_assert(is_serializable_v<SerializableT>, "deserializeRemixApiT(...)  may only be called with defined Serializable<T> types");
   void* pSlzdData = nullptr;
   const auto size = DeviceBridge::get_data(&pSlzdData);
+  // An empty packet means the client serialized into the SharedHeap,
+  // deserialize straight out of the allocation
+  if (size == 0) {
+    const auto allocId = (SharedHeap::AllocId) DeviceBridge::get_data();
+    pSlzdData = SharedHeap::getBuf(allocId);
+  }
   SerializableT dslz(pSlzdData);
-  assert(size == dslz.size());
+  assert(size == 0 || size == dslz.size());
   dslz.deserialize();
   serializableT = std::move(dslz);
 }
+
+// Deserializes from a blob of back to back serialized structs and advances the cursor
+template<typename SerializableT>
+static void deserializeFromBlob(SerializableT& serializableT, const uint8_t*& pBlob) {
+  static_assert(is_serializable_v<SerializableT>, "deserializeFromBlob(...)  may only be called with defined Serializable<T> types");
+  SerializableT dslz((void*) pBlob);
+  dslz.deserialize();
+  pBlob += dslz.size();
+  serializableT = std::move(dslz);
+}
 }
 
 static inline void safeDestroy(IUnknown* obj, uint32_t x86handle) {
@@ -170,6 +200,103 @@ static inline void safeDestroy(IUnknown* obj, uint32_t x86handle) {
   while (obj && static_cast<LONG>(obj->Release()) > 0);
 }
 
+static HRESULT setFVF(IDirect3DDevice9* pD3DDevice, const DWORD FVF) {
+  if (!ServerOptions::getCacheFvfDeclarations() || FVF == 0) {
+    return pD3DDevice->SetFVF(FVF);
+  }
+
+  auto& fvfDecls = gFvfDeclarations[pD3DDevice];
+  const auto it = fvfDecls.find(FVF);
+  if (it != fvfDecls.end()) {
+    return pD3DDevice->SetVertexDeclaration(it->second);
+  }
+
+  // Let the runtime translate the FVF once and keep the declaration it created
+  const HRESULT hresult = pD3DDevice->SetFVF(FVF);
+  if (SUCCEEDED(hresult)) {
+    IDirect3DVertexDeclaration9* pDecl = nullptr;
+    if (SUCCEEDED(pD3DDevice->GetVertexDeclaration(&pDecl)) && pDecl) {
+      fvfDecls[FVF] = pDecl;
+    }
+  }
+  return hresult;
+}
+
+static void releaseFvfDeclarations(IDirect3DDevice9* pD3DDevice) {
+  const auto it = gFvfDeclarations.find(pD3DDevice);
+  if (it == gFvfDeclarations.end()) {
+    return;
+  }
+  for (auto& fvfDecl : it->second) {
+    fvfDecl.second->Release();
+  }
+  gFvfDeclarations.erase(it);
+}
+
+// Queries whose results are pushed to the client through QueryResults, by
+// query handle. The generation counts D3DISSUE_END issues like the client does.
+struct PushedQuery {
+  uint32_t slot;
+  uint32_t generation;
+  bool bPending;
+};
+std::unordered_map<uint32_t, PushedQuery> gPushedQueries;
+// Handles of pushed queries issued but not yet published
+std::vector<uint32_t> gPendingQueries;
+// Commands between polls of the pending queries outside of Present
+constexpr uint32_t kQueryPollInterval = 64;
+
+static void publishQueryResult(const uint32_t handle, PushedQuery& query, const HRESULT hresult,
+                               const void* pData, const DWORD size) {
+  QueryResults::write(query.slot, handle, query.generation, hresult, pData, size);
+  query.bPending = false;
+}
+
+// Publishes the results of all pending queries that are available by now
+static void pollPendingQueries() {
+  if (gPendingQueries.empty()) {
+    return;
+  }
+  ZoneScoped;
+  uint8_t data[QueryResults::kMaxDataSize];
+  auto isDone = [&data](const uint32_t handle) {
+    const auto it = gPushedQueries.find(handle);
+    if (it == gPushedQueries.end() || !it->second.bPending) {
+      return true;
+    }
+    IDirect3DQuery9* const pQuery = gpD3DQuery[handle];
+    if (pQuery == nullptr) {
+      return true;
+    }
+    const DWORD size = std::min<DWORD>(pQuery->GetDataSize(), sizeof(data));
+    const HRESULT hresult = pQuery->GetData(data, size, 0);
+    if (hresult == S_FALSE) {
+      return false;
+    }
+    publishQueryResult(handle, it->second, hresult, data, size);
+    return true;
+  };
+  gPendingQueries.erase(std::remove_if(gPendingQueries.begin(), gPendingQueries.end(), isDone),
+                        gPendingQueries.end());
+}
+
+// Called for every Present processed. Publishes the server frame count for
+// the client's present pacing and reports how many frames the client has
+// already presented beyond this one.
+static void onPresentProcessed() {
+  // Hand the input gathered during the frame to the renderer in one batch
+  InputRing::drain();
+  pollPendingQueries();
+
+  auto& serverFrames = *DeviceBridge::getWriterChannel().writerFrameCount;
+  serverFrames.fetch_add(1, std::memory_order_release);
+#ifdef TRACY_ENABLE
+  const uint32_t numPresents = serverFrames.load(std::memory_order_relaxed);
+  const uint32_t clientFrames = DeviceBridge::getReaderChannel().writerFrameCount->load(std::memory_order_relaxed);
+  TracyPlot(PlotNames::ClientLead, (int64_t) (int32_t) (clientFrames - numPresents));
+#endif
+}
+
 D3DPRESENT_PARAMETERS getPresParamFromRaw(const uint32_t* rawPresentationParameters) {
   D3DPRESENT_PARAMETERS presParam;
   // Set up presentation parameters. We can't just directly cast the structure because the hDeviceWindow
@@ -242,14 +369,40 @@ HRESULT ReturnSurfaceDataToClient(IDirect3DSurface9* pReturnSurfaceData, HRESULT
   return hresult;
 }
 
+// Copies the surface into the client's SharedHeap allocation with tightly
+// packed rows, matching the client surface's own buffer layout, so that the
+// client can adopt the allocation as is. The fence is signaled even on
+// failure, since the client waits on it before touching the allocation.
+static HRESULT WriteSurfaceDataToSharedHeap(IDirect3DSurface9* pSurface, HRESULT hresult,
+                                            const SharedHeap::AllocId allocId, const SharedHeap::Fence fence) {
+  D3DSURFACE_DESC desc;
+  if (SUCCEEDED(hresult)) {
+    hresult = pSurface->GetDesc(OUT & desc);
+  }
+  D3DLOCKED_RECT lockedRect;
+  if (SUCCEEDED(hresult)) {
+    hresult = pSurface->LockRect(OUT & lockedRect, NULL, IN D3DLOCK_READONLY);
+  }
+  if (SUCCEEDED(hresult)) {
+    const size_t rowSize = bridge_util::calcRowSize(desc.Width, desc.Format);
+    const size_t numRows = bridge_util::calcStride(desc.Height, desc.Format);
+    fastCopyRows(SharedHeap::getBuf(allocId), rowSize, lockedRect.pBits, lockedRect.Pitch, rowSize, numRows);
+    hresult = pSurface->UnlockRect();
+  } else {
+    Logger::err(format_string("Surface readback into the SharedHeap failed with %x.", hresult));
+  }
+  SharedHeap::signalFence(fence);
+  return hresult;
+}
+
 template<typename T>
 static bool dumpLeakedObjects(const char* name, const T& map) {
   if (!map.empty()) {
     bridge_util::Logger::err(format_string("%zd objects discovered in %s map at "
                               "Direct3D module eviction:", map.size(), name));
-    for (auto& [handle, obj] : map) {
+    map.forEach([](const uint32_t handle, const auto* obj) {
       bridge_util::Logger::err(format_string("\t%x -> %p", handle, obj));
-    }
+    });
     return true;
   }
   return false;
@@ -271,7 +424,45 @@ static bool dumpLeakedObjects() {
   return anyLeaked;
 }
 
+// Commands that can never observe the contents of a resource other than their own
+// handle, and therefore may run while uploads to other resources are in flight.
+static bool isUploadIndependentCommand(const D3D9Command command) {
+  switch (command) {
+  case IDirect3DSurface9_UnlockRect:
+  case IDirect3DVertexBuffer9_Unlock:
+  case IDirect3DIndexBuffer9_Unlock:
+  case IDirect3DDevice9Ex_CreateTexture:
+  case IDirect3DDevice9Ex_CreateVolumeTexture:
+  case IDirect3DDevice9Ex_CreateCubeTexture:
+  case IDirect3DDevice9Ex_CreateVertexBuffer:
+  case IDirect3DDevice9Ex_CreateIndexBuffer:
+  case IDirect3DTexture9_GetSurfaceLevel:
+  case IDirect3DCubeTexture9_GetCubeMapSurface:
+  case IDirect3DDevice9Ex_SetTransform:
+  case IDirect3DDevice9Ex_MultiplyTransform:
+  case IDirect3DDevice9Ex_SetRenderState:
+  case IDirect3DDevice9Ex_SetTextureStageState:
+  case IDirect3DDevice9Ex_SetSamplerState:
+  case IDirect3DDevice9Ex_SetVertexShaderConstantF:
+  case IDirect3DDevice9Ex_SetVertexShaderConstantI:
+  case IDirect3DDevice9Ex_SetVertexShaderConstantB:
+  case IDirect3DDevice9Ex_SetPixelShaderConstantF:
+  case IDirect3DDevice9Ex_SetPixelShaderConstantI:
+  case IDirect3DDevice9Ex_SetPixelShaderConstantB:
+  case Bridge_SharedHeap_AddSeg:
+  case Bridge_SharedHeap_Alloc:
+  case Bridge_DataStreamChunk:
+    return true;
+  default:
+    return false;
+  }
+}
+
 void ProcessDeviceCommandQueue() {
+  if (ServerOptions::getUploadWorkerCount() > 0) {
+    gpUploadPool = std::make_unique<UploadPool>(ServerOptions::getUploadWorkerCount());
+  }
+
   // Loop until the client sends terminate instruction
   bool done = false;
   while (!done && DeviceBridge::waitForCommand() == Result::Success) {
@@ -293,13 +484,24 @@ void ProcessDeviceCommandQueue() {
     }
 #endif
 
-    {
-      ZoneScoped;
-      if (ZoneIsActive) {
-        const std::string commandStr = toString(rpcHeader.command);
-        ZoneName(commandStr.c_str(), commandStr.size());
+    // Retire uploads this command depends on before executing it
+    if (gpUploadPool && !gpUploadPool->isIdle()) {
+      if (isUploadIndependentCommand(rpcHeader.command)) {
+        gpUploadPool->wait(rpcHeader.pHandle);
+        gpUploadPool->retireFinished();
+      } else {
+        gpUploadPool->waitAll();
       }
+    }
+
+    {
+      ZoneScopedCommand(rpcHeader.command);
+#if defined(TRACY_ENABLE) && !defined(USE_BLOCKING_QUEUE)
+      TracyPlot(PlotNames::CommandQueueOccupancy, (int64_t) DeviceBridge::getReaderChannel().commands->getOccupancy());
+#endif
       PULL_U(currentUID);
+      ApiTrace::record(ApiTrace::Event::Execute, rpcHeader.command, rpcHeader.flags, rpcHeader.pHandle,
+                       currentUID, rpcHeader.dataOffset);
 #if defined(_DEBUG) || defined(DEBUGOPT)
       if (GlobalOptions::getLogServerCommands()) {
         Logger::info("Device Processing: " + toString(rpcHeader.command) + " UID: " + std::to_string(currentUID));
@@ -330,6 +532,9 @@ void ProcessDeviceCommandQueue() {
         } else {
           Logger::info("Server side D3D9 DeviceEx created successfully!");
           gpD3DDevices[pHandle] = pD3DDevice;
+          if (GlobalOptions::getEnableShaderCache()) {
+            gShaderCache.warmUp(pD3DDevice);
+          }
           if(GlobalOptions::getExposeRemixApi()) {
             remixapi::g_device = pD3DDevice;
             remixapi::g_remix.dxvk_RegisterD3D9Device(remixapi::g_device);
@@ -365,6 +570,9 @@ void ProcessDeviceCommandQueue() {
         } else {
           Logger::info("Server side D3D9 Device created successfully!");
           gpD3DDevices[pHandle] = (IDirect3DDevice9Ex*) pD3DDevice;
+          if (GlobalOptions::getEnableShaderCache()) {
+            gShaderCache.warmUp(pD3DDevice);
+          }
           if(GlobalOptions::getExposeRemixApi()) {
             remixapi::g_device = (IDirect3DDevice9Ex*) pD3DDevice;
             remixapi::g_remix.dxvk_RegisterD3D9Device(remixapi::g_device);
@@ -501,6 +709,8 @@ void ProcessDeviceCommandQueue() {
       case IDirect3DDevice9Ex_Destroy:
       {
         GET_RES(pD3DDevice, gpD3DDevices);
+        gShaderCache.purge(pD3DDevice);
+        releaseFvfDeclarations(pD3DDevice);
         safeDestroy(pD3DDevice, pD3DDeviceHandle);
         gpD3DDevices.erase(pD3DDeviceHandle);
         break;
@@ -689,6 +899,7 @@ void ProcessDeviceCommandQueue() {
       case IDirect3DDevice9Ex_Present:
       {
         FrameMark;
+        Metrics::endFrame();
 #ifdef ENABLE_PRESENT_SEMAPHORE_TRACE
         Logger::trace("Server side Present call received, releasing semaphore...");
 #endif
@@ -708,6 +919,7 @@ void ProcessDeviceCommandQueue() {
           Logger::err(ss.str());
         }
 
+        onPresentProcessed();
         // If we're syncing with the client on Present() then trigger the semaphore now
         if (GlobalOptions::getPresentSemaphoreEnabled()) {
           gpPresent->release();
@@ -932,6 +1144,12 @@ void ProcessDeviceCommandQueue() {
         const auto& pRenderTarget = (IDirect3DSurface9*) gpD3DResources[pRenderTargetHandle];
         const auto& pDestSurface = (IDirect3DSurface9*) gpD3DResources[pDestSurfaceHandle];
         auto hresult = pD3DDevice->GetRenderTargetData(IN pRenderTarget, IN pDestSurface);
+        if (Commands::IsDataInSharedHeap(rpcHeader.flags)) {
+          PULL_U(allocId);
+          PULL_U(fence);
+          hresult = WriteSurfaceDataToSharedHeap(pDestSurface, hresult, allocId, fence);
+          break;
+        }
         hresult = ReturnSurfaceDataToClient(pDestSurface, hresult, currentUID);
         assert(SUCCEEDED(hresult));
         break;
@@ -944,6 +1162,12 @@ void ProcessDeviceCommandQueue() {
         const auto& pDestSurface = (IDirect3DSurface9*) gpD3DResources[pDestSurfaceHandle];
         IDirect3DSurface9* pBackbuffer = nullptr;
         auto hresult = pD3DDevice->GetFrontBufferData(IN iSwapChain, IN pDestSurface);
+        if (Commands::IsDataInSharedHeap(rpcHeader.flags)) {
+          PULL_U(allocId);
+          PULL_U(fence);
+          hresult = WriteSurfaceDataToSharedHeap(pDestSurface, hresult, allocId, fence);
+          break;
+        }
         hresult = ReturnSurfaceDataToClient(pDestSurface, hresult, currentUID);
         assert(SUCCEEDED(hresult));
         break;
@@ -1413,7 +1637,7 @@ void ProcessDeviceCommandQueue() {
       {
         GET_RES(pD3DDevice, gpD3DDevices);
         PULL_D(FVF);
-        const auto hresult = pD3DDevice->SetFVF(IN FVF);
+        const auto hresult = setFVF(pD3DDevice, FVF);
         assert(SUCCEEDED(hresult));
         SEND_OPTIONAL_SERVER_RESPONSE(hresult, currentUID);
         break;
@@ -1424,11 +1648,22 @@ void ProcessDeviceCommandQueue() {
       {
         GET_RES(pD3DDevice, gpD3DDevices);
         PULL_HND(pHandle);
+        PULL_U(hashLo);
+        PULL_U(hashHi);
         PULL_U(dataSize);
         DWORD* pFunction = nullptr;
-        PULL_DATA(dataSize, pFunction);
+        if (dataSize > 0) {
+          PULL_DATA(dataSize, pFunction);
+        }
         IDirect3DVertexShader9* pShader = nullptr;
-        const auto hresult = pD3DDevice->CreateVertexShader(IN pFunction, OUT & pShader);
+        HRESULT hresult;
+        if (GlobalOptions::getEnableShaderCache()) {
+          const uint64_t hash = ((uint64_t) hashHi << 32) | hashLo;
+          pShader = static_cast<IDirect3DVertexShader9*>(
+            gShaderCache.acquire(pD3DDevice, ShaderCache::Type::Vertex, hash, pFunction, dataSize, hresult));
+        } else {
+          hresult = pD3DDevice->CreateVertexShader(IN pFunction, OUT & pShader);
+        }
         if (SUCCEEDED(hresult)) {
           gpD3DVertexShaders[pHandle] = pShader;
         }
@@ -1542,11 +1777,22 @@ void ProcessDeviceCommandQueue() {
       {
         GET_RES(pD3DDevice, gpD3DDevices);
         PULL_HND(pHandle);
+        PULL_U(hashLo);
+        PULL_U(hashHi);
         PULL_U(dataSize);
         DWORD* pFunction = nullptr;
-        PULL_DATA(dataSize, pFunction);
+        if (dataSize > 0) {
+          PULL_DATA(dataSize, pFunction);
+        }
         IDirect3DPixelShader9* pShader = nullptr;
-        const auto hresult = pD3DDevice->CreatePixelShader(IN pFunction, OUT & pShader);
+        HRESULT hresult;
+        if (GlobalOptions::getEnableShaderCache()) {
+          const uint64_t hash = ((uint64_t) hashHi << 32) | hashLo;
+          pShader = static_cast<IDirect3DPixelShader9*>(
+            gShaderCache.acquire(pD3DDevice, ShaderCache::Type::Pixel, hash, pFunction, dataSize, hresult));
+        } else {
+          hresult = pD3DDevice->CreatePixelShader(IN pFunction, OUT & pShader);
+        }
         if (SUCCEEDED(hresult)) {
           gpD3DPixelShaders[pHandle] = pShader;
         }
@@ -1678,11 +1924,15 @@ void ProcessDeviceCommandQueue() {
         GET_RES(pD3DDevice, gpD3DDevices);
         PULL(D3DQUERYTYPE, Type);
         PULL_HND(pHandle);
+        PULL_U(resultSlot);
         IDirect3DQuery9* ppQuery;
         const auto hresult = pD3DDevice->CreateQuery(IN Type, OUT & ppQuery);
         if (SUCCEEDED(hresult)) {
           gpD3DQuery[pHandle] = ppQuery;
         }
+        if (resultSlot != QueryResults::kNoSlot) {
+          gPushedQueries[pHandle] = PushedQuery { resultSlot, 0, false };
+        }
         break;
       }
       /*
@@ -1738,6 +1988,7 @@ void ProcessDeviceCommandQueue() {
       case IDirect3DSwapChain9_Present:
       {
         FrameMark;
+        Metrics::endFrame();
 #ifdef ENABLE_PRESENT_SEMAPHORE_TRACE
         Logger::trace("Server side Present call received, releasing semaphore...");
 #endif
@@ -1758,6 +2009,7 @@ void ProcessDeviceCommandQueue() {
           ss << "Present() failed! Check all logs for reported errors.";
         }
 
+        onPresentProcessed();
         // If we're syncing with the client on Present() then trigger the semaphore now
         if (GlobalOptions::getPresentSemaphoreEnabled()) {
           gpPresent->release();
@@ -1776,6 +2028,12 @@ void ProcessDeviceCommandQueue() {
         if (SUCCEEDED(hresult)) {
           gpD3DResources[pDestSurfaceHandle] = pDestSurface;
         }
+        if (Commands::IsDataInSharedHeap(rpcHeader.flags)) {
+          PULL_U(allocId);
+          PULL_U(fence);
+          hresult = WriteSurfaceDataToSharedHeap(pDestSurface, hresult, allocId, fence);
+          break;
+        }
         hresult = ReturnSurfaceDataToClient(pDestSurface, hresult, currentUID);
         assert(SUCCEEDED(hresult));
         break;
@@ -1883,7 +2141,9 @@ void ProcessDeviceCommandQueue() {
       {
         GET_HND(pHandle);
         const auto& pVertexShader = gpD3DVertexShaders[pHandle];
-        safeDestroy(pVertexShader, pHandle);
+        if (!gShaderCache.release(pVertexShader)) {
+          safeDestroy(pVertexShader, pHandle);
+        }
         gpD3DVertexShaders.erase(pHandle);
         break;
       }
@@ -1908,7 +2168,9 @@ void ProcessDeviceCommandQueue() {
       {
         GET_HND(pHandle);
         const auto& pPixelShader = gpD3DPixelShaders[pHandle];
-        safeDestroy(pPixelShader, pHandle);
+        if (!gShaderCache.release(pPixelShader)) {
+          safeDestroy(pPixelShader, pHandle);
+        }
         gpD3DPixelShaders.erase(pHandle);
         break;
       }
@@ -2190,22 +2452,19 @@ void ProcessDeviceCommandQueue() {
         void* data = nullptr;
         const auto slice_size = row_size * height;
         size_t pulledSize = DeviceBridge::get_data(&data);
-#endif
+        fastCopyBox(pLockedVolume.pBits, pLockedVolume.RowPitch, pLockedVolume.SlicePitch,
+                    data, row_size, slice_size, row_size, height, depth);
+        assert(pulledSize == depth * slice_size);
+#else
         for (uint32_t z = 0; z < depth; z++) {
           for (uint32_t y = 0; y < height; y++) {
             auto ptr = (uintptr_t) pLockedVolume.pBits + y * pLockedVolume.RowPitch + z * pLockedVolume.SlicePitch;
-#ifdef SEND_ALL_LOCK_DATA_AT_ONCE
-            auto row = (uintptr_t) data + y * row_size + z * slice_size;
-#else
             void* row = nullptr;
             const auto read_size = DeviceBridge::get_data(&row);
             assert(row_size == read_size);
-#endif
             memcpy((void*) ptr, (void*) row, row_size);
           }
         }
-#ifdef SEND_ALL_LOCK_DATA_AT_ONCE
-        assert(pulledSize == depth * slice_size);
 #endif
         hresult = pVolumeTexture->UnlockBox(Level);
         assert(SUCCEEDED(hresult));
@@ -2385,19 +2644,42 @@ void ProcessDeviceCommandQueue() {
 
         // Copy the data over
         void* data = nullptr;
+        SharedHeap::Fence fence = SharedHeap::kNullFence;
         if (Commands::IsDataReserved(rpcHeader.flags)) {
           PULL_D(DataOffset);
           data = DeviceBridge::Bridge::getReaderChannel().get_data_ptr() + DataOffset;
         } else if (Commands::IsDataInSharedHeap(rpcHeader.flags)) {
           PULL_U(allocId);
           data = SharedHeap::getBuf(allocId) + OffsetToLock;
+          if (Commands::IsDataFenced(rpcHeader.flags)) {
+            PULL_U(fenceValue);
+            fence = fenceValue;
+          }
         } else {
           const auto size = DeviceBridge::get_data(&data);
           assert(SizeToLock == size);
         }
-        memcpy(pbData, data, SizeToLock);
+        // Fenced data must be signaled in order, so only unfenced SharedHeap copies go async
+        if (gpUploadPool && Commands::IsDataInSharedHeap(rpcHeader.flags) &&
+            fence == SharedHeap::kNullFence && SizeToLock >= ServerOptions::getAsyncUploadThreshold()) {
+          IDirect3DVertexBuffer9* const pBuffer = pVertexBuffer;
+          gpUploadPool->submit(pHandle,
+            [pbData, data, SizeToLock]() {
+              fastMemcpy(pbData, data, SizeToLock);
+            },
+            [pBuffer]() {
+              const auto unlockResult = pBuffer->Unlock();
+              assert(SUCCEEDED(unlockResult));
+            });
+          break;
+        }
+        fastMemcpy(pbData, data, SizeToLock);
         hresult = pVertexBuffer->Unlock();
         assert(SUCCEEDED(hresult));
+        if (fence != SharedHeap::kNullFence) {
+          // Let the client recycle the region
+          SharedHeap::signalFence(fence);
+        }
 
         break;
       }
@@ -2471,19 +2753,42 @@ void ProcessDeviceCommandQueue() {
 
         // Copy the data over
         void* data = nullptr;
+        SharedHeap::Fence fence = SharedHeap::kNullFence;
         if (Commands::IsDataReserved(rpcHeader.flags)) {
           PULL_D(DataOffset);
           data = DeviceBridge::Bridge::getReaderChannel().get_data_ptr() + DataOffset;
         } else if (Commands::IsDataInSharedHeap(rpcHeader.flags)) {
           PULL_U(allocId);
           data = SharedHeap::getBuf(allocId) + OffsetToLock;
+          if (Commands::IsDataFenced(rpcHeader.flags)) {
+            PULL_U(fenceValue);
+            fence = fenceValue;
+          }
         } else {
           const auto size = DeviceBridge::get_data(&data);
           assert(SizeToLock == size);
         }
-        memcpy(pbData, data, SizeToLock);
+        // Fenced data must be signaled in order, so only unfenced SharedHeap copies go async
+        if (gpUploadPool && Commands::IsDataInSharedHeap(rpcHeader.flags) &&
+            fence == SharedHeap::kNullFence && SizeToLock >= ServerOptions::getAsyncUploadThreshold()) {
+          IDirect3DIndexBuffer9* const pBuffer = pIndexBuffer;
+          gpUploadPool->submit(pHandle,
+            [pbData, data, SizeToLock]() {
+              fastMemcpy(pbData, data, SizeToLock);
+            },
+            [pBuffer]() {
+              const auto unlockResult = pBuffer->Unlock();
+              assert(SUCCEEDED(unlockResult));
+            });
+          break;
+        }
+        fastMemcpy(pbData, data, SizeToLock);
         hresult = pIndexBuffer->Unlock();
         assert(SUCCEEDED(hresult));
+        if (fence != SharedHeap::kNullFence) {
+          // Let the client recycle the region
+          SharedHeap::signalFence(fence);
+        }
         break;
       }
       case IDirect3DIndexBuffer9_GetDesc:
@@ -2550,6 +2855,12 @@ void ProcessDeviceCommandQueue() {
         // Currently we only recieve calls for LockRect in cases where backbuffer data is to be copied for screenshots
         GET_HND(pHandle);
         const auto pSurface = (IDirect3DSurface9*) gpD3DResources[pHandle];
+        if (Commands::IsDataInSharedHeap(rpcHeader.flags)) {
+          PULL_U(allocId);
+          PULL_U(fence);
+          WriteSurfaceDataToSharedHeap(pSurface, S_OK, allocId, fence);
+          break;
+        }
         HRESULT hresult = ReturnSurfaceDataToClient(pSurface, S_OK, currentUID);
         assert(SUCCEEDED(hresult));
         break;
@@ -2586,9 +2897,21 @@ void ProcessDeviceCommandQueue() {
           const size_t numRows = bridge_util::calcStride(height, format);
           assert(pulledSize == numRows * IncomingPitch);
         }
-        FOR_EACH_RECT_ROW(lockedRect, height, format,
-          memcpy(ptr, (PBYTE) pData + y * IncomingPitch, rowSize);
-        )
+        const size_t numRows = bridge_util::calcStride(height, format);
+        // SharedHeap data stays valid until the client deallocates it, which waits for
+        // all uploads, so large copies from it can complete asynchronously
+        if (gpUploadPool && useSharedHeap && rowSize * numRows >= ServerOptions::getAsyncUploadThreshold()) {
+          gpUploadPool->submit(pHandle,
+            [lockedRect, pData, IncomingPitch, rowSize, numRows]() {
+              fastCopyRows(lockedRect.pBits, lockedRect.Pitch, pData, IncomingPitch, rowSize, numRows);
+            },
+            [pSurface]() {
+              const auto unlockResult = pSurface->UnlockRect();
+              assert(SUCCEEDED(unlockResult));
+            });
+          break;
+        }
+        fastCopyRows(lockedRect.pBits, lockedRect.Pitch, pData, IncomingPitch, rowSize, numRows);
         hresult = pSurface->UnlockRect();
         assert(SUCCEEDED(hresult));
 
@@ -2664,22 +2987,19 @@ void ProcessDeviceCommandQueue() {
         void* data = nullptr;
         const auto slice_size = row_size * height;
         size_t pulledSize = DeviceBridge::get_data(&data);
-#endif
+        fastCopyBox(pLockedVolume.pBits, pLockedVolume.RowPitch, pLockedVolume.SlicePitch,
+                    data, row_size, slice_size, row_size, height, depth);
+        assert(pulledSize == depth * slice_size);
+#else
         for (uint32_t z = 0; z < depth; z++) {
           for (uint32_t y = 0; y < height; y++) {
             auto ptr = (uintptr_t) pLockedVolume.pBits + y * pLockedVolume.RowPitch + z * pLockedVolume.SlicePitch;
-#ifdef SEND_ALL_LOCK_DATA_AT_ONCE
-            auto row = (uintptr_t) data + y * row_size + z * slice_size;
-#else
             void* row = nullptr;
             const auto read_size = DeviceBridge::get_data(&row);
             assert(row_size == read_size);
-#endif
             memcpy((void*) ptr, (void*) row, row_size);
           }
         }
-#ifdef SEND_ALL_LOCK_DATA_AT_ONCE
-        assert(pulledSize == depth * slice_size);
 #endif
         hresult = pVolume->UnlockBox();
         assert(SUCCEEDED(hresult));
@@ -2699,6 +3019,8 @@ void ProcessDeviceCommandQueue() {
         const auto& pQuery = (IDirect3DQuery9*) gpD3DQuery[pHandle];
         safeDestroy(pQuery, pHandle);
         gpD3DQuery.erase(pHandle);
+        // Dropped from gPendingQueries on the next poll
+        gPushedQueries.erase(pHandle);
         break;
       }
       case IDirect3DQuery9_GetDevice:
@@ -2713,6 +3035,18 @@ void ProcessDeviceCommandQueue() {
         PULL(DWORD, dwIssueFlags);
         const auto &pQuery = gpD3DQuery[pHandle];
         const auto hresult = pQuery->Issue(dwIssueFlags);
+        if (dwIssueFlags & D3DISSUE_END) {
+          const auto it = gPushedQueries.find(pHandle);
+          if (it != gPushedQueries.end()) {
+            ++it->second.generation;
+            if (FAILED(hresult)) {
+              publishQueryResult(pHandle, it->second, hresult, nullptr, 0);
+            } else if (!it->second.bPending) {
+              it->second.bPending = true;
+              gPendingQueries.push_back(pHandle);
+            }
+          }
+        }
         SEND_OPTIONAL_SERVER_RESPONSE(hresult, currentUID);
         break;
       }
@@ -2727,6 +3061,13 @@ void ProcessDeviceCommandQueue() {
           pData = new char[dwSize];
         }
         const auto hresult = pQuery->GetData(pData, dwSize, dwGetDataFlags);
+        // A readiness check without a result buffer leaves the query pending
+        if (hresult != S_FALSE && (pData != NULL || FAILED(hresult))) {
+          const auto it = gPushedQueries.find(pHandle);
+          if (it != gPushedQueries.end() && it->second.bPending) {
+            publishQueryResult(pHandle, it->second, hresult, pData, dwSize);
+          }
+        }
 
         ServerMessage c(Commands::Bridge_Response, currentUID);
         c.send_data(hresult);
@@ -2784,6 +3125,11 @@ void ProcessDeviceCommandQueue() {
         SharedHeap::deallocate(allocId);
         break;
       }
+      case Bridge_DataStreamChunk:
+      {
+        DeviceBridge::receive_stream_chunk((DeviceBridge::StreamId) rpcHeader.pHandle);
+        break;
+      }
       case Bridge_UnlinkResource:
       {
         GET_HND(pHandle);
@@ -2801,6 +3147,7 @@ void ProcessDeviceCommandQueue() {
        */
       case RemixApi_CreateMaterial:
       {
+        DeserializeArena::Scope arenaScope;
         // Rather than allocate deserialized struct extensions on the heap,
         // allocate them locally, since we know only one instance will be
         // supported at a time
@@ -2890,6 +3237,7 @@ void ProcessDeviceCommandQueue() {
 
       case RemixApi_CreateMesh:
       {
+        DeserializeArena::Scope arenaScope;
         const auto meshInfoSType = remixapi::pullSType();
         assert(meshInfoSType == REMIXAPI_STRUCT_TYPE_MESH_INFO);
         serialize::MeshInfo meshInfo;
@@ -2931,6 +3279,7 @@ void ProcessDeviceCommandQueue() {
 
       case RemixApi_DrawInstance:
       {
+        DeserializeArena::Scope arenaScope;
         // Rather than allocate deserialized struct extensions on the heap,
         // allocate them locally, since we know only one instance will be
         // supported at a time
@@ -3000,8 +3349,102 @@ void ProcessDeviceCommandQueue() {
         break;
       }
 
+      case RemixApi_DrawInstanceBatch:
+      {
+        DeserializeArena::Scope arenaScope;
+        const uint32_t count = (uint32_t) DeviceBridge::get_data();
+        const uint32_t* pCategoryFlags = nullptr;
+        const uint32_t* pMeshes = nullptr;
+        const remixapi_Transform* pTransforms = nullptr;
+        const uint32_t* pDoubleSided = nullptr;
+        const uint32_t* pExtensionOffsets = nullptr;
+        const uint8_t* pExtensions = nullptr;
+        DeviceBridge::get_data((void**) &pCategoryFlags);
+        DeviceBridge::get_data((void**) &pMeshes);
+        DeviceBridge::get_data((void**) &pTransforms);
+        DeviceBridge::get_data((void**) &pDoubleSided);
+        DeviceBridge::get_data((void**) &pExtensionOffsets);
+        DeviceBridge::get_data((void**) &pExtensions);
+
+        for (uint32_t iInst = 0; iInst < count; ++iInst) {
+          struct InstanceExtensions {
+            serialize::InstanceInfoObjectPicking objectPicking;
+            serialize::InstanceInfoBlend blend;
+            serialize::InstanceInfoTransforms boneXforms;
+          } exts;
+          memset(&exts, 0, sizeof(InstanceExtensions));
+
+          remixapi_InstanceInfo instInfo;
+          instInfo.sType = REMIXAPI_STRUCT_TYPE_INSTANCE_INFO;
+          instInfo.pNext = nullptr;
+          instInfo.categoryFlags = pCategoryFlags[iInst];
+          instInfo.transform = pTransforms[iInst];
+          instInfo.doubleSided = pDoubleSided[iInst];
+
+          MeshHandle meshHandle(pMeshes[iInst]);
+          if(meshHandle.isValid()) {
+            instInfo.mesh = meshHandle;
+          } else {
+            instInfo.mesh = (remixapi_MeshHandle) (uintptr_t) pMeshes[iInst];
+            Logger::err("[RemixApi_DrawInstanceBatch] Invalid mesh handle!" );
+          }
+
+          if (pExtensionOffsets[iInst] != remixapi::batch::kNoExtensions) {
+            const uint8_t* pExt = pExtensions + pExtensionOffsets[iInst];
+            auto* pInfoProto = &getInfoProto(instInfo);
+            bool bInstExtExists = true;
+            while (bInstExtExists) {
+              uint32_t extSType;
+              memcpy(&extSType, pExt, sizeof(extSType));
+              pExt += sizeof(extSType);
+              switch (extSType) {
+                case REMIXAPI_STRUCT_TYPE_NONE:
+                {
+                  bInstExtExists = false;
+                  break;
+                }
+                case REMIXAPI_STRUCT_TYPE_INSTANCE_INFO_OBJECT_PICKING_EXT:
+                {
+                  deserializeFromBlob(exts.objectPicking, pExt);
+                  pInfoProto->pNext = &(exts.objectPicking);
+                  pInfoProto = &getInfoProto(exts.objectPicking);
+                  break;
+                }
+                case REMIXAPI_STRUCT_TYPE_INSTANCE_INFO_BLEND_EXT:
+                {
+                  deserializeFromBlob(exts.blend, pExt);
+                  pInfoProto->pNext = &(exts.blend);
+                  pInfoProto = &getInfoProto(exts.blend);
+                  break;
+                }
+                case REMIXAPI_STRUCT_TYPE_INSTANCE_INFO_BONE_TRANSFORMS_EXT:
+                {
+                  deserializeFromBlob(exts.boneXforms, pExt);
+                  pInfoProto->pNext = &(exts.boneXforms);
+                  pInfoProto = &getInfoProto(exts.boneXforms);
+                  break;
+                }
+                default:
+                {
+                  // The client only encodes known extensions, the rest of the chain can't be parsed
+                  Logger::err("[RemixApi_DrawInstanceBatch] Unknown sType in extension chain. Skipping the rest.");
+                  bInstExtExists = false;
+                  break;
+                }
+              }
+            }
+          }
+
+          if(remixapi::g_remix.DrawInstance(&instInfo) != REMIXAPI_ERROR_CODE_SUCCESS) {
+            Logger::err("[RemixApi_DrawInstanceBatch] Remix API call failed!");
+          }
+        }
+        break;
+      }
+
       case RemixApi_CreateLight:
       {
+        DeserializeArena::Scope arenaScope;
         // Rather than allocate deserialized struct extensions on the heap,
         // allocate them locally, since we know only one instance will be
         // supported at a time
@@ -3186,6 +3629,12 @@ void ProcessDeviceCommandQueue() {
     Logger::trace(format_string("Finished batch data read with %d data items.", count));
 #endif
 
+    static uint32_t numCommandsSincePoll = 0;
+    if (++numCommandsSincePoll >= kQueryPollInterval) {
+      numCommandsSincePoll = 0;
+      pollPendingQueries();
+    }
+
 #ifdef LOG_SERVER_COMMAND_TIME
     // See how long processing this command took
     const auto diff = GetTickCount64() - start;
@@ -3196,6 +3645,9 @@ void ProcessDeviceCommandQueue() {
 #endif
   }
 
+  // Finish outstanding uploads while the resources are still alive
+  gpUploadPool.reset();
+
   // Check if we exited the command processing loop unexpectedly while the bridge is still enabled
   if (!done && gbBridgeRunning) {
     Logger::debug("The device command processing loop was exited unexpectedly, either due to timing out or some other command queue issue.");
@@ -3413,6 +3865,7 @@ int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance,
   Config::init(Config::App::Server);
   GlobalOptions::init();
   Logger::init();
+  ApiTrace::init();
 
   // Always setup exception handler on server
   ExceptionHandler::get().init();
@@ -3443,6 +3896,9 @@ int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance,
 
   initModuleBridge();
   initDeviceBridge();
+  Metrics::init();
+  InputRing::init();
+  QueryResults::init();
 
   if (GlobalOptions::getUseSharedHeap()) {
     SharedHeap::init();
@@ -3450,8 +3906,20 @@ int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance,
 
   gpPresent = new NamedSemaphore("Present", GlobalOptions::getPresentSemaphoreMaxFrames(), GlobalOptions::getPresentSemaphoreMaxFrames());
 
+  // (1) Load d3d9.dll, which could be original system, dxvk-remix, or something else...
+  // This happens before the handshake so the renderer loads while the client
+  // and the game are still starting up, rather than while the client waits on us.
+  Logger::info("Initializing D3D9...");
+  const auto initD3DStart = std::chrono::steady_clock::now();
+  if (!InitializeD3D()) {
+    return 1;
+  }
+  const auto initD3DEnd = std::chrono::steady_clock::now();
+  Logger::info(format_string("[Startup] D3D9 initialized in %lld ms.",
+    std::chrono::duration_cast<std::chrono::milliseconds>(initD3DEnd - initD3DStart).count()));
+
   // Initialize our shared client command queue as a Reader.
-  // (1) Wait for connection for client.
+  // (2) Wait for connection for client.
   Logger::info("Server started up, waiting for connection from client...");
   const auto waitForSynResult = DeviceBridge::waitForCommand(Bridge_Syn, GlobalOptions::getStartupTimeout());
   switch (waitForSynResult) {
@@ -3476,12 +3944,8 @@ int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance,
   RegisterExitCallback(synResponse.pHandle);
 
   RegisterMessageChannel();
-
-  // (2) Load d3d9.dll, which could be original system, dxvk-remix, or something else...
-  Logger::info("Initializing D3D9...");
-  if (!InitializeD3D()) {
-    return 1;
-  }
+  Logger::info(format_string("[Startup] Client connected %lld ms after D3D9 was initialized.",
+    std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - initD3DEnd).count()));
 
   // (3) Send ACK to Client. Connection has been established
   Logger::info("Sync request received, sending ACK response...");
@@ -3509,6 +3973,12 @@ int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance,
   // (5) Ready to listen for incoming commands
   Logger::info("Handshake completed! Now waiting for incoming commands...");
 
+  const bool bPersistShaderCache = GlobalOptions::getEnableShaderCache() &&
+                                   !ServerOptions::getShaderCacheFile().empty();
+  if (bPersistShaderCache) {
+    gShaderCache.beginLoad(ServerOptions::getShaderCacheFile());
+  }
+
   std::atomic<bool> bSignalDone(false);
   auto moduleCmdProcessingThread = std::thread([&]() {
     processModuleCommandQueue(&bSignalDone);
@@ -3517,6 +3987,11 @@ int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance,
   ProcessDeviceCommandQueue();
   bSignalDone.store(true);
   moduleCmdProcessingThread.join();
+  InputRing::shutdown();
+
+  if (bPersistShaderCache) {
+    gShaderCache.save(ServerOptions::getShaderCacheFile());
+  }
 
   if (!dumpLeakedObjects()) {
     bridge_util::Logger::debug("No leaked objects dicovered at Direct3D module eviction.");
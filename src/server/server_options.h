@@ -48,4 +48,34 @@ namespace ServerOptions {
       bridge_util::Config::getOption<uint32_t>("server.shutdownRetries", 50);
     return shutdownRetries;
   }
+
+  // Number of worker threads copying large SharedHeap payloads of surface and buffer
+  // unlocks off the command thread. A value of 0 keeps all copies on the command thread.
+  inline uint32_t getUploadWorkerCount() {
+    static const uint32_t uploadWorkerCount =
+      bridge_util::Config::getOption<uint32_t>("server.uploadWorkerCount", 0);
+    return uploadWorkerCount;
+  }
+  // Minimum payload size in bytes for an upload to be copied asynchronously.
+  inline uint32_t getAsyncUploadThreshold() {
+    static const uint32_t asyncUploadThreshold =
+      bridge_util::Config::getOption<uint32_t>("server.asyncUploadThreshold", 256 * 1024);
+    return asyncUploadThreshold;
+  }
+
+  // File the shader cache bytecode is saved to at exit and loaded from at startup, in order
+  // to create known shaders along with the device. Empty disables the on-disk cache.
+  inline const std::string& getShaderCacheFile() {
+    static const std::string shaderCacheFile =
+      bridge_util::Config::getOption<std::string>("server.shaderCacheFile", "");
+    return shaderCacheFile;
+  }
+
+  // Translates each FVF code into a vertex declaration once and sets the cached
+  // declaration on subsequent SetFVF calls with the same code.
+  inline bool getCacheFvfDeclarations() {
+    static const bool cacheFvfDeclarations =
+      bridge_util::Config::getOption<bool>("server.cacheFvfDeclarations", false);
+    return cacheFvfDeclarations;
+  }
 }
\ No newline at end of file
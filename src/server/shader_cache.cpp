@@ -0,0 +1,271 @@
+/*
+ * Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#include "shader_cache.h"
+
+#include "log/log.h"
+
+#include "../tracy/tracy.hpp"
+
+#include <cstring>
+#include <fstream>
+
+using namespace bridge_util;
+
+namespace {
+  constexpr uint32_t kCacheFileMagic = 0x43535242; // "BRSC"
+  constexpr uint32_t kCacheFileVersion = 2;
+}
+
+ShaderCache::~ShaderCache() {
+  stopWarmUp();
+  if (m_pendingLoad.valid()) {
+    m_pendingLoad.wait();
+  }
+}
+
+void ShaderCache::beginLoad(const std::string& path) {
+  m_pendingLoad = std::async(std::launch::async, &ShaderCache::load, path);
+}
+
+std::vector<ShaderCache::Record> ShaderCache::load(const std::string& path) {
+  ZoneScoped;
+  std::vector<Record> records;
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    Logger::info(format_string("[ShaderCache] No shader cache found at %s.", path.c_str()));
+    return records;
+  }
+  uint32_t magic = 0, version = 0;
+  file.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+  file.read(reinterpret_cast<char*>(&version), sizeof(version));
+  if (!file || magic != kCacheFileMagic || version != kCacheFileVersion) {
+    Logger::warn(format_string("[ShaderCache] Ignoring incompatible shader cache %s.", path.c_str()));
+    return records;
+  }
+  while (file) {
+    Record record;
+    uint32_t size = 0;
+    file.read(reinterpret_cast<char*>(&record.type), sizeof(record.type));
+    file.read(reinterpret_cast<char*>(&record.hash), sizeof(record.hash));
+    file.read(reinterpret_cast<char*>(&size), sizeof(size));
+    if (!file || record.type > Type::Pixel || size == 0 || size % sizeof(DWORD) != 0) {
+      break;
+    }
+    record.bytecode.resize(size);
+    file.read(reinterpret_cast<char*>(record.bytecode.data()), size);
+    if (!file) {
+      break;
+    }
+    records.emplace_back(std::move(record));
+  }
+  Logger::info(format_string("[ShaderCache] Loaded %zd shaders from %s.", records.size(), path.c_str()));
+  return records;
+}
+
+void ShaderCache::save(const std::string& path) {
+  // Shaders still being loaded from disk are saved as well
+  stopWarmUp();
+  if (m_pendingLoad.valid()) {
+    for (auto& record : m_pendingLoad.get()) {
+      m_bytecode[(uint32_t) record.type].emplace(record.hash, std::move(record.bytecode));
+    }
+  }
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  if (!file) {
+    Logger::warn(format_string("[ShaderCache] Unable to write shader cache to %s.", path.c_str()));
+    return;
+  }
+  std::lock_guard<std::mutex> lock(m_mutex);
+  file.write(reinterpret_cast<const char*>(&kCacheFileMagic), sizeof(kCacheFileMagic));
+  file.write(reinterpret_cast<const char*>(&kCacheFileVersion), sizeof(kCacheFileVersion));
+  size_t count = 0;
+  for (uint32_t type = 0; type < 2; ++type) {
+    for (const auto& [hash, bytecode] : m_bytecode[type]) {
+      const uint32_t size = (uint32_t) bytecode.size();
+      file.write(reinterpret_cast<const char*>(&type), sizeof(type));
+      file.write(reinterpret_cast<const char*>(&hash), sizeof(hash));
+      file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+      file.write(reinterpret_cast<const char*>(bytecode.data()), size);
+      ++count;
+    }
+  }
+  Logger::info(format_string("[ShaderCache] Saved %zd shaders to %s.", count, path.c_str()));
+}
+
+IUnknown* ShaderCache::create(IDirect3DDevice9* pDevice, const Type type, const DWORD* pFunction, HRESULT& hresult) {
+  IUnknown* pShader = nullptr;
+  if (type == Type::Vertex) {
+    hresult = pDevice->CreateVertexShader(pFunction, reinterpret_cast<IDirect3DVertexShader9**>(&pShader));
+  } else {
+    hresult = pDevice->CreatePixelShader(pFunction, reinterpret_cast<IDirect3DPixelShader9**>(&pShader));
+  }
+  return SUCCEEDED(hresult) ? pShader : nullptr;
+}
+
+void ShaderCache::insert(EntryMap& map, const uint64_t hash, IUnknown* pShader) {
+  map[hash] = pShader;
+  m_owned[pShader].bCacheRef = true;
+}
+
+void ShaderCache::warmUp(IDirect3DDevice9* pDevice) {
+  stopWarmUp();
+  D3DDEVICE_CREATION_PARAMETERS params;
+  const bool bCreate = SUCCEEDED(pDevice->GetCreationParameters(&params)) &&
+                       (params.BehaviorFlags & D3DCREATE_MULTITHREADED) != 0;
+  if (!bCreate && !m_pendingLoad.valid()) {
+    return;
+  }
+  m_stopWarmUp.store(false);
+  m_warmUp = std::async(std::launch::async, &ShaderCache::warmUpWorker, this, pDevice, bCreate);
+}
+
+void ShaderCache::stopWarmUp() {
+  if (m_warmUp.valid()) {
+    m_stopWarmUp.store(true);
+    m_warmUp.wait();
+    m_warmUp = {};
+  }
+}
+
+void ShaderCache::warmUpWorker(IDirect3DDevice9* pDevice, const bool bCreate) {
+  ZoneScoped;
+  if (m_pendingLoad.valid()) {
+    auto records = m_pendingLoad.get();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto& record : records) {
+      m_bytecode[(uint32_t) record.type].emplace(record.hash, std::move(record.bytecode));
+    }
+  }
+  if (!bCreate) {
+    return;
+  }
+
+  std::vector<std::pair<Type, const BytecodeMap::value_type*>> pending;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (uint32_t type = 0; type < 2; ++type) {
+      for (const auto& code : m_bytecode[type]) {
+        pending.emplace_back((Type) type, &code);
+      }
+    }
+  }
+  size_t numCreated = 0;
+  for (const auto& [type, pCode] : pending) {
+    if (m_stopWarmUp.load()) {
+      break;
+    }
+    HRESULT hresult;
+    IUnknown* const pShader = create(pDevice, type, reinterpret_cast<const DWORD*>(pCode->second.data()), hresult);
+    if (pShader == nullptr) {
+      continue;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto& map = m_entries[(uint32_t) type][pDevice];
+    // The command thread may have created it in the meantime
+    if (map.find(pCode->first) != map.end()) {
+      pShader->Release();
+      continue;
+    }
+    insert(map, pCode->first, pShader);
+    ++numCreated;
+  }
+  Logger::info(format_string("[ShaderCache] Created %zd shaders from cache.", numCreated));
+}
+
+IUnknown* ShaderCache::acquire(IDirect3DDevice9* pDevice, const Type type, const uint64_t hash,
+                               const DWORD* pFunction, const uint32_t size, HRESULT& hresult) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto& bytecodes = m_bytecode[(uint32_t) type];
+  auto code = bytecodes.find(hash);
+  if (pFunction != nullptr) {
+    const uint8_t* const pBytes = reinterpret_cast<const uint8_t*>(pFunction);
+    if (code == bytecodes.end()) {
+      code = bytecodes.emplace(hash, std::vector<uint8_t>(pBytes, pBytes + size)).first;
+    } else if (code->second.size() != size || memcmp(code->second.data(), pFunction, size) != 0) {
+      // Hash collision, leave the shader out of the cache
+      return create(pDevice, type, pFunction, hresult);
+    }
+  } else if (code == bytecodes.end()) {
+    Logger::err(format_string("[ShaderCache] Shader with hash 0x%llx is not in cache!", hash));
+    hresult = D3DERR_INVALIDCALL;
+    return nullptr;
+  }
+
+  // Shaders first requested on this device, or by hash only, are created from the known bytecode
+  auto& map = m_entries[(uint32_t) type][pDevice];
+  auto it = map.find(hash);
+  if (it == map.end()) {
+    IUnknown* const pShader = create(pDevice, type, reinterpret_cast<const DWORD*>(code->second.data()), hresult);
+    if (pShader == nullptr) {
+      return nullptr;
+    }
+    // The cache holds on to the reference from creation and the handle gets another one
+    insert(map, hash, pShader);
+    it = map.find(hash);
+  }
+  IUnknown* const pShader = it->second;
+  pShader->AddRef();
+  ++m_owned[pShader].numHandles;
+  hresult = D3D_OK;
+  return pShader;
+}
+
+bool ShaderCache::release(IUnknown* pShader) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto it = m_owned.find(pShader);
+  if (it == m_owned.end()) {
+    return false;
+  }
+  Owner& owner = it->second;
+  if (owner.numHandles > 0) {
+    --owner.numHandles;
+    pShader->Release();
+  }
+  if (owner.numHandles == 0 && !owner.bCacheRef) {
+    m_owned.erase(it);
+  }
+  return true;
+}
+
+void ShaderCache::purge(IDirect3DDevice9* pDevice) {
+  // The warm up may still be creating shaders on this device
+  stopWarmUp();
+  // Bytecode is kept around to be saved and for recreating the shaders on a new device.
+  // Only the cache reference is dropped, shaders still used by handles stay tracked
+  // so that their last destroy goes through release() as well.
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for (auto& devices : m_entries) {
+    auto it = devices.find(pDevice);
+    if (it == devices.end()) {
+      continue;
+    }
+    for (auto& [hash, pShader] : it->second) {
+      auto owner = m_owned.find(pShader);
+      owner->second.bCacheRef = false;
+      if (owner->second.numHandles == 0) {
+        m_owned.erase(owner);
+      }
+      pShader->Release();
+    }
+    devices.erase(it);
+  }
+}
@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+
+#include <d3d9.h>
+
+#include <atomic>
+#include <future>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Server side cache of vertex and pixel shader objects keyed by bytecode hash.
+//
+// The bytecode of every shader seen is kept for the lifetime of the server, so that the
+// client can refer to bytecode it already sent by hash alone, on any device. Each device
+// shares one shader object between all client handles created from the same bytecode, and
+// the cache keeps its own reference to it while the device lives. The bytecode can be saved
+// to disk at exit and loaded again on the next run, to create those shaders up front.
+class ShaderCache {
+public:
+  enum class Type : uint32_t {
+    Vertex = 0,
+    Pixel = 1
+  };
+
+  ~ShaderCache();
+
+  // Starts reading a cache file written by save() on a background thread.
+  void beginLoad(const std::string& path);
+  // Starts creating the shaders loaded from disk on a background thread. Shaders are only
+  // created up front on devices that allow calls from other threads (D3DCREATE_MULTITHREADED),
+  // on other devices they are created when first requested.
+  void warmUp(IDirect3DDevice9* pDevice);
+  // Writes the bytecode of every known shader to disk.
+  void save(const std::string& path);
+
+  // Returns the shader for given bytecode, creating it if needed, with a reference owned by
+  // the caller's handle. pFunction may be null if the bytecode was sent before by the client.
+  IUnknown* acquire(IDirect3DDevice9* pDevice, const Type type, const uint64_t hash,
+                    const DWORD* pFunction, const uint32_t size, HRESULT& hresult);
+  // Drops a handle reference. Returns false if the shader is not owned by the cache.
+  bool release(IUnknown* pShader);
+  // Drops the cache references to every shader created on given device.
+  void purge(IDirect3DDevice9* pDevice);
+
+private:
+  struct Record {
+    Type type;
+    uint64_t hash;
+    std::vector<uint8_t> bytecode;
+  };
+  // A shared shader stays tracked until the cache and every handle dropped their
+  // references, the cache reference goes away first when its device is purged.
+  struct Owner {
+    uint32_t numHandles = 0;
+    bool bCacheRef = false;
+  };
+  using EntryMap = std::unordered_map<uint64_t, IUnknown*>;
+  using BytecodeMap = std::unordered_map<uint64_t, std::vector<uint8_t>>;
+
+  void warmUpWorker(IDirect3DDevice9* pDevice, const bool bCreate);
+  void stopWarmUp();
+  void insert(EntryMap& map, const uint64_t hash, IUnknown* pShader);
+  static IUnknown* create(IDirect3DDevice9* pDevice, const Type type, const DWORD* pFunction, HRESULT& hresult);
+  static std::vector<Record> load(const std::string& path);
+
+  // Bytecode is never removed or modified once added, so its storage stays valid
+  // without holding the lock.
+  BytecodeMap m_bytecode[2];
+  std::unordered_map<IDirect3DDevice9*, EntryMap> m_entries[2];
+  std::unordered_map<IUnknown*, Owner> m_owned;
+  std::mutex m_mutex;
+
+  std::future<std::vector<Record>> m_pendingLoad;
+  std::future<void> m_warmUp;
+  std::atomic<bool> m_stopWarmUp { false };
+};
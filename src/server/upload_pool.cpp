@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#include "upload_pool.h"
+
+#include "../tracy/tracy.hpp"
+
+UploadPool::UploadPool(const uint32_t numWorkers) {
+  for (uint32_t i = 0; i < numWorkers; ++i) {
+    m_workers.emplace_back([this]() {
+      workerLoop();
+    });
+  }
+}
+
+UploadPool::~UploadPool() {
+  waitAll();
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_shutdown = true;
+  }
+  m_workAvailable.notify_all();
+  for (auto& worker : m_workers) {
+    worker.join();
+  }
+}
+
+void UploadPool::submit(const uint32_t handle, Task copy, Task complete) {
+  wait(handle);
+  auto job = std::make_shared<Job>();
+  job->copy = std::move(copy);
+  job->complete = std::move(complete);
+  m_inFlight[handle] = job;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_queue.push_back(std::move(job));
+  }
+  m_workAvailable.notify_one();
+}
+
+void UploadPool::wait(const uint32_t handle) {
+  auto it = m_inFlight.find(handle);
+  if (it == m_inFlight.end()) {
+    return;
+  }
+  const auto job = std::move(it->second);
+  m_inFlight.erase(it);
+  waitForJob(job);
+  job->complete();
+}
+
+void UploadPool::waitAll() {
+  ZoneScoped;
+  for (auto& [handle, job] : m_inFlight) {
+    waitForJob(job);
+    job->complete();
+  }
+  m_inFlight.clear();
+}
+
+void UploadPool::retireFinished() {
+  for (auto it = m_inFlight.begin(); it != m_inFlight.end();) {
+    bool bDone;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      bDone = it->second->done;
+    }
+    if (bDone) {
+      it->second->complete();
+      it = m_inFlight.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void UploadPool::waitForJob(const std::shared_ptr<Job>& job) {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_jobDone.wait(lock, [&job]() {
+    return job->done;
+  });
+}
+
+void UploadPool::workerLoop() {
+  while (true) {
+    std::shared_ptr<Job> job;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_workAvailable.wait(lock, [this]() {
+        return m_shutdown || !m_queue.empty();
+      });
+      if (m_queue.empty()) {
+        return;
+      }
+      job = std::move(m_queue.front());
+      m_queue.pop_front();
+    }
+    {
+      ZoneScopedN("Upload Copy");
+      job->copy();
+    }
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      job->done = true;
+    }
+    m_jobDone.notify_all();
+  }
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Worker pool copying large resource payloads off the command thread.
+//
+// The command thread locks the resource, submits the copy and moves on. The resource
+// stays locked until its upload is retired, at which point the completion callback
+// (typically the Unlock call) runs on the command thread again, so that D3D is only
+// ever called from the command thread. Every resource handle with an upload in flight
+// acts as a fence: commands using that resource must wait() on it first, and commands
+// that may consume resource contents in general must waitAll().
+class UploadPool {
+public:
+  using Task = std::function<void()>;
+
+  explicit UploadPool(const uint32_t numWorkers);
+  ~UploadPool();
+
+  UploadPool(const UploadPool&) = delete;
+  UploadPool& operator=(const UploadPool&) = delete;
+
+  // Queues the copy for a resource, waiting for a previous upload to the same resource first.
+  void submit(const uint32_t handle, Task copy, Task complete);
+
+  bool isIdle() const {
+    return m_inFlight.empty();
+  }
+  bool isInFlight(const uint32_t handle) const {
+    return m_inFlight.find(handle) != m_inFlight.end();
+  }
+
+  // Waits for the upload of given resource, if any, and retires it.
+  void wait(const uint32_t handle);
+  // Waits for and retires every upload in flight.
+  void waitAll();
+  // Retires uploads that have already finished without blocking.
+  void retireFinished();
+
+private:
+  struct Job {
+    Task copy;
+    Task complete;
+    bool done = false;
+  };
+
+  void workerLoop();
+  void waitForJob(const std::shared_ptr<Job>& job);
+
+  // Only touched by the command thread
+  std::unordered_map<uint32_t, std::shared_ptr<Job>> m_inFlight;
+
+  std::mutex m_mutex;
+  std::condition_variable m_workAvailable;
+  std::condition_variable m_jobDone;
+  std::deque<std::shared_ptr<Job>> m_queue;
+  bool m_shutdown = false;
+  std::vector<std::thread> m_workers;
+};
@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+// Prints the live metrics published by a running bridge when the liveMetrics
+// option is enabled, or exports them as CSV.
+//
+// Usage: NvRemixBridgeMetrics <bridge GUID> [--csv] [--interval <ms>] [--samples <count>]
+//
+// The bridge GUID is printed to the client log at startup.
+
+#include "util_metrics.h"
+
+#include <windows.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+using bridge_util::Metrics;
+
+static const char* const kProcessNames[] = { "client", "server" };
+static const char* const kChannelNames[] = { "module", "device" };
+
+static void printHeaderCsv() {
+  printf("process,pid,frame,frameTimeUs");
+  for (const auto* channel : kChannelNames) {
+    printf(",%s.commands,%s.bytes,%s.dataQueueHighWater,%s.overwriteStalls,%s.pushRetries",
+           channel, channel, channel, channel, channel);
+  }
+  printf(",presentWaitUs,sharedHeapBytes,sharedHeapSegments,allowedLead,framesInFlight\n");
+}
+
+static void printCsv(const char* process, const uint32_t pid, const Metrics::Frame& frame) {
+  printf("%s,%u,%llu,%llu", process, pid, frame.frameIndex, frame.frameTimeUs);
+  for (const auto& channel : frame.channels) {
+    printf(",%llu,%llu,%llu,%llu,%llu", channel.commands, channel.bytes, channel.dataQueueHighWater,
+           channel.overwriteStalls, channel.pushRetries);
+  }
+  printf(",%llu,%llu,%llu,%llu,%llu\n", frame.presentWaitUs, frame.sharedHeapBytes, frame.sharedHeapSegments,
+         frame.allowedLead, frame.framesInFlight);
+}
+
+static void printText(const char* process, const uint32_t pid, const Metrics::Frame& frame) {
+  printf("[%s pid %u] frame %llu, %.2f ms\n", process, pid, frame.frameIndex, frame.frameTimeUs / 1000.0);
+  for (uint32_t i = 0; i < (uint32_t) Metrics::Channel::Count; ++i) {
+    const auto& channel = frame.channels[i];
+    printf("  %s: %llu commands, %llu bytes, data queue high-water %llu bytes, %llu overwrite stalls, %llu push retries\n",
+           kChannelNames[i], channel.commands, channel.bytes, channel.dataQueueHighWater,
+           channel.overwriteStalls, channel.pushRetries);
+  }
+  printf("  present wait: %llu us, shared heap: %llu bytes in %llu segments\n",
+         frame.presentWaitUs, frame.sharedHeapBytes, frame.sharedHeapSegments);
+  printf("  frames in flight: %llu, allowed lead: %llu\n", frame.framesInFlight, frame.allowedLead);
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s <bridge GUID> [--csv] [--interval <ms>] [--samples <count>]\n", argv[0]);
+    return 1;
+  }
+
+  bool csv = false;
+  DWORD intervalMs = 1000;
+  uint32_t numSamples = 0;
+  for (int i = 2; i < argc; ++i) {
+    if (strcmp(argv[i], "--csv") == 0) {
+      csv = true;
+    } else if (strcmp(argv[i], "--interval") == 0 && i + 1 < argc) {
+      intervalMs = (DWORD) strtoul(argv[++i], nullptr, 10);
+    } else if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc) {
+      numSamples = (uint32_t) strtoul(argv[++i], nullptr, 10);
+    } else {
+      fprintf(stderr, "Unknown argument %s\n", argv[i]);
+      return 1;
+    }
+  }
+
+  const std::string name = std::string(Metrics::kSharedMemoryName) + "_" + argv[1];
+  const HANDLE hMapping = OpenFileMappingA(FILE_MAP_READ, FALSE, name.c_str());
+  if (hMapping == NULL) {
+    fprintf(stderr, "Unable to open %s (error code %lu). Is the bridge running with liveMetrics enabled?\n",
+            name.c_str(), GetLastError());
+    return 1;
+  }
+  const auto* const pBlock = static_cast<const Metrics::Block*>(
+    MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, sizeof(Metrics::Block)));
+  if (pBlock == nullptr) {
+    fprintf(stderr, "Unable to map %s (error code %lu)\n", name.c_str(), GetLastError());
+    CloseHandle(hMapping);
+    return 1;
+  }
+  if (memcmp(pBlock->magic, Metrics::kMagic, sizeof(pBlock->magic)) != 0 ||
+      pBlock->version != Metrics::kVersion) {
+    fprintf(stderr, "%s does not contain bridge metrics version %u\n", name.c_str(), Metrics::kVersion);
+    UnmapViewOfFile(pBlock);
+    CloseHandle(hMapping);
+    return 1;
+  }
+
+  if (csv) {
+    printHeaderCsv();
+  }
+  uint64_t lastFrame[(uint32_t) Metrics::Process::Count] = { UINT64_MAX, UINT64_MAX };
+  for (uint32_t sample = 0; numSamples == 0 || sample < numSamples; ++sample) {
+    for (uint32_t i = 0; i < (uint32_t) Metrics::Process::Count; ++i) {
+      const auto& section = pBlock->sections[i];
+      Metrics::Frame frame;
+      // Skip sections that were never published to or have not changed since the last sample
+      if (section.processId == 0 || !Metrics::readSection(section, frame) || frame.frameIndex == lastFrame[i]) {
+        continue;
+      }
+      lastFrame[i] = frame.frameIndex;
+      if (csv) {
+        printCsv(kProcessNames[i], section.processId, frame);
+      } else {
+        printText(kProcessNames[i], section.processId, frame);
+      }
+    }
+    fflush(stdout);
+    Sleep(intervalMs);
+  }
+
+  UnmapViewOfFile(pBlock);
+  CloseHandle(hMapping);
+  return 0;
+}
@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+// Decodes the binary trace files written when the apiTrace option is enabled.
+//
+// Usage: NvRemixBridgeTraceDecoder <trace file> [output file]
+
+#include "util_apitrace.h"
+#include "util_commands.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+using bridge_util::ApiTrace;
+
+static const char* toString(const ApiTrace::Event event) {
+  switch (event) {
+  case ApiTrace::Event::Send: return "Send";
+  case ApiTrace::Event::Execute: return "Execute";
+  default: return "Unknown";
+  }
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s <trace file> [output file]\n", argv[0]);
+    return 1;
+  }
+
+  FILE* pIn = nullptr;
+  if (fopen_s(&pIn, argv[1], "rb") != 0 || pIn == nullptr) {
+    fprintf(stderr, "Unable to open trace file %s\n", argv[1]);
+    return 1;
+  }
+
+  ApiTrace::FileHeader header;
+  if (fread(&header, sizeof(header), 1, pIn) != 1 ||
+      memcmp(header.magic, ApiTrace::kMagic, sizeof(header.magic)) != 0) {
+    fprintf(stderr, "%s is not a bridge trace file\n", argv[1]);
+    fclose(pIn);
+    return 1;
+  }
+  if (header.version != ApiTrace::kVersion) {
+    fprintf(stderr, "Unsupported trace version %u, expected %u\n", header.version, ApiTrace::kVersion);
+    fclose(pIn);
+    return 1;
+  }
+
+  std::vector<ApiTrace::Record> records(header.numRecords);
+  const size_t numRead = fread(records.data(), sizeof(ApiTrace::Record), records.size(), pIn);
+  fclose(pIn);
+  if (numRead != records.size()) {
+    fprintf(stderr, "Trace file is truncated, decoding %zu of %zu records\n", numRead, records.size());
+    records.resize(numRead);
+  }
+
+  FILE* pOut = stdout;
+  if (argc > 2 && (fopen_s(&pOut, argv[2], "w") != 0 || pOut == nullptr)) {
+    fprintf(stderr, "Unable to open output file %s\n", argv[2]);
+    return 1;
+  }
+
+  fprintf(pOut, "# %u-bit trace, %zu records\n", header.pointerBits, records.size());
+  fprintf(pOut, "%14s %8s %-8s %-48s %10s %6s %10s %10s\n",
+          "time (us)", "thread", "event", "command", "handle", "flags", "uid", "offset");
+
+  const uint64_t start = records.empty() ? 0 : records.front().timestamp;
+  const double usPerTick = header.frequency ? 1000000.0 / (double) header.frequency : 0.0;
+  for (const auto& record : records) {
+    const double timeUs = (double) (record.timestamp - start) * usPerTick;
+    const auto command = static_cast<Commands::D3D9Command>(record.command);
+    fprintf(pOut, "%14.3f %8u %-8s %-48s 0x%08x 0x%04x %10u %10u\n",
+            timeUs, record.threadId, toString(record.event), Commands::toString(command).c_str(),
+            record.handle, record.flags, record.args[0], record.args[1]);
+  }
+
+  if (pOut != stdout) {
+    fclose(pOut);
+  }
+  return 0;
+}
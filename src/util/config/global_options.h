@@ -172,6 +172,22 @@ public:
     return get().logLevel;
   }
 
+  static bool getAsyncLogging() {
+    return get().asyncLogging;
+  }
+
+  static bool getApiTrace() {
+    return get().apiTrace;
+  }
+
+  static bool getLiveMetrics() {
+    return get().liveMetrics;
+  }
+
+  static bool getInputRing() {
+    return get().inputRing;
+  }
+
   static uint16_t getKeyStateCircBufMaxSize() {
     return get().keyStateCircBufMaxSize;
   }
@@ -184,6 +200,10 @@ public:
     return get().presentSemaphoreEnabled;
   }
 
+  static bool getAdaptivePresentPacing() {
+    return get().adaptivePresentPacing;
+  }
+
   static bool getCommandBatchingEnabled() {
     return get().commandBatchingEnabled;
   }
@@ -216,6 +236,10 @@ public:
     return get().sharedHeapFreeChunkWaitTimeout;
   }
 
+  static const uint32_t getSharedHeapDynamicBufferRingSize() {
+    return get().sharedHeapDynamicBufferRingSize;
+  }
+
   static const uint32_t getSemaphoreTimeout() {
     return get().commandTimeout;
   }
@@ -243,6 +267,14 @@ public:
   static const bool getAlwaysCopyEntireStaticBuffer() {
     return get().alwaysCopyEntireStaticBuffer;
   }
+
+  static const bool getStaticBufferPageHashing() {
+    return get().staticBufferPageHashing;
+  }
+
+  static const bool getEnableShaderCache() {
+    return get().enableShaderCache;
+  }
   
 
   static bool getExposeRemixApi() {
@@ -372,18 +404,38 @@ private:
     const auto strLevel = bridge_util::Config::getOption<std::string>("logLevel", kDefaultLogLevel);
     logLevel = bridge_util::str_to_loglevel(strLevel);
 
+    // Queues log messages in per-thread rings and leaves formatting and file I/O
+    // to a background writer thread.
+    asyncLogging = bridge_util::Config::getOption<bool>("asyncLogging", false);
+
+    // Records a compact binary trace of every command sent and processed, which
+    // is written to the log folder at exit or on a crash. Works in all builds.
+    apiTrace = bridge_util::Config::getOption<bool>("apiTrace", false);
+
+    // Publishes per-frame bridge health counters to shared memory for the
+    // NvRemixBridgeMetrics tool.
+    liveMetrics = bridge_util::Config::getOption<bool>("liveMetrics", false);
+
     // We use a simple circular buffer to track user input state in order to send
     // it over the bridge for dxvk developer/user overlay manipulation. This sets
     // the max size of the circ buffer, which stores 2B elements. 100 is probably
     // overkill, but it's a fairly small cost.
     keyStateCircBufMaxSize = bridge_util::Config::getOption<uint16_t>("keyStateCircBufMaxSize", 100);
 
+    // Sends input window messages to the server through a shared memory ring
+    // that is drained once per server frame instead of one thread message each.
+    inputRing = bridge_util::Config::getOption<bool>("inputRing", true);
+
     // This is the maximum latency in number of frames the client can be ahead of the
     // server before it blocks and waits for the server to catch up. We want this value
     // to be rather small so the two processes don't get too far out of sync.
     presentSemaphoreMaxFrames = bridge_util::Config::getOption<uint8_t>("presentSemaphoreMaxFrames", 3);
     presentSemaphoreEnabled = bridge_util::Config::getOption<bool>("presentSemaphoreEnabled", true);
 
+    // Lets the client pick how many frames it may be ahead of the server, up to
+    // presentSemaphoreMaxFrames, based on measured client and server frame times.
+    adaptivePresentPacing = bridge_util::Config::getOption<bool>("adaptivePresentPacing", false);
+
     // Toggles between waiting on and triggering the command queue semaphore for each
     // command separately when batching is off compared to waiting for it only once per
     // frame, used in conjunction with the Present semaphore above. Fewer semaphore
@@ -418,12 +470,26 @@ private:
     // The number of seconds to wait for a avaliable chunk to free up in the shared heap
     sharedHeapFreeChunkWaitTimeout = bridge_util::Config::getOption<uint32_t>("sharedHeapFreeChunkWaitTimeout", 10);
 
+    // Maximum number of SharedHeap regions a dynamic buffer cycles through on D3DLOCK_DISCARD.
+    // Regions are recycled once the server has consumed them, instead of being deallocated
+    // and reallocated on every discard. A value of 0 or 1 restores the allocate-per-discard behavior.
+    sharedHeapDynamicBufferRingSize = bridge_util::Config::getOption<uint32_t>("sharedHeapDynamicBufferRingSize", 4);
+
     // Thread-safety policy: 0 - use client's choice, 1 - force thread-safe, 2 - force non-thread-safe
     threadSafetyPolicy = bridge_util::Config::getOption<uint32_t>("threadSafetyPolicy", 0);
 
     // If set and a buffer is not dynamic, vertex and index buffer lock/unlocks will ignore the bounds set during the lock call
     // and the brifge will copy the entire buffer. This means
     alwaysCopyEntireStaticBuffer = bridge_util::Config::getOption<bool>("alwaysCopyEntireStaticBuffer", false);
+
+    // If set, non-dynamic vertex and index buffers keep a hash of every 4kB page of their contents
+    // and on unlock only the pages whose hash changed are sent, regardless of the locked range.
+    // Takes precedence over alwaysCopyEntireStaticBuffer.
+    staticBufferPageHashing = bridge_util::Config::getOption<bool>("staticBufferPageHashing", false);
+
+    // If set, the client sends shader bytecode only once per device and refers to it by hash
+    // afterwards, while the server shares one shader object between all handles of the same bytecode.
+    enableShaderCache = bridge_util::Config::getOption<bool>("enableShaderCache", false);
   
     exposeRemixApi = bridge_util::Config::getOption<bool>("exposeRemixApi", false);
 
@@ -466,9 +532,14 @@ private:
   uint32_t commandRetries;
   bool infiniteRetries;
   bridge_util::LogLevel logLevel;
+  bool asyncLogging;
+  bool apiTrace;
+  bool liveMetrics;
   uint16_t keyStateCircBufMaxSize;
+  bool inputRing;
   uint8_t presentSemaphoreMaxFrames;
   bool presentSemaphoreEnabled;
+  bool adaptivePresentPacing;
   bool commandBatchingEnabled;
   bool disableTimeoutsWhenDebugging;
   bool disableTimeouts;
@@ -478,8 +549,11 @@ private:
   uint32_t sharedHeapDefaultSegmentSize;
   uint32_t sharedHeapChunkSize;
   uint32_t sharedHeapFreeChunkWaitTimeout;
+  uint32_t sharedHeapDynamicBufferRingSize;
   uint32_t threadSafetyPolicy;
   bool alwaysCopyEntireStaticBuffer;
+  bool staticBufferPageHashing;
+  bool enableShaderCache;
   bool exposeRemixApi;
   bool eliminateRedundantSetterCalls;
 };
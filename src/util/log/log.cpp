@@ -26,10 +26,18 @@
 #include "util_filesys.h"
 #include "util_process.h"
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <iomanip>
 #include <sstream>
+#include <thread>
+#include <vector>
 #include <assert.h>
 
 #ifndef _WIN32
@@ -39,28 +47,279 @@
 using namespace dxvk::util;
 
 namespace bridge_util {
-  template<int N>
-  static inline void getLocalTimeString(char (&timeString)[N]) {
-    // [HH:MM:SS.MS]
-    static const char* format = "[%02d:%02d:%02d.%03d]";
+  struct LogTime {
+    uint16_t hour;
+    uint16_t minute;
+    uint16_t second;
+    uint16_t millisecond;
+  };
 
+  static inline LogTime getLocalTime() {
 #ifdef _WIN32
     SYSTEMTIME lt;
     GetLocalTime(&lt);
 
-    sprintf_s(timeString, format,
-              lt.wHour, lt.wMinute, lt.wSecond, lt.wMilliseconds);
+    return { lt.wHour, lt.wMinute, lt.wSecond, lt.wMilliseconds };
 #else
     struct timeval tv;
     gettimeofday(&tv, NULL);
 
     struct tm* lt = localtime(&tv.tv_sec);
 
-    sprintf_s(timeString, format,
-              lt->tm_hour, lt->tm_min, lt->tm_sec, (tv.tv_usec / 1000) % 1000);
+    return { (uint16_t) lt->tm_hour, (uint16_t) lt->tm_min, (uint16_t) lt->tm_sec,
+             (uint16_t) ((tv.tv_usec / 1000) % 1000) };
 #endif
   }
 
+  template<int N>
+  static inline void getTimeString(const LogTime& time, char (&timeString)[N]) {
+    // [HH:MM:SS.MS]
+    static const char* format = "[%02d:%02d:%02d.%03d]";
+
+    sprintf_s(timeString, format,
+              time.hour, time.minute, time.second, time.millisecond);
+  }
+
+  template<int N>
+  static inline void getLocalTimeString(char (&timeString)[N]) {
+    getTimeString(getLocalTime(), timeString);
+  }
+
+  // Asynchronous logging backend. Every logging thread owns a single-producer ring of
+  // fixed size records, so queueing a message only copies its text. Long messages span
+  // several consecutive records. A writer thread periodically drains all rings, orders
+  // the messages by their global sequence number, then formats and writes them.
+  namespace {
+    constexpr size_t kRecordTextSize = 232;
+    constexpr size_t kRingRecords = 1024;
+    constexpr auto kWriterInterval = std::chrono::milliseconds(10);
+    // How long flush() waits for a lock that may be held by a thread that is gone
+    constexpr auto kFlushLockTimeout = std::chrono::milliseconds(100);
+    // How long shutdown waits for the writer thread to exit
+    constexpr auto kWriterStopTimeout = std::chrono::milliseconds(500);
+
+    struct LogRecord {
+      uint64_t sequence;
+      LogTime time;
+      LogLevel level;
+      uint16_t length;
+      // The message continues in the next record
+      bool continued;
+      char text[kRecordTextSize];
+    };
+
+    struct LogRing {
+      std::array<LogRecord, kRingRecords> records;
+      // Written by the producing thread only
+      std::atomic<size_t> head = 0;
+      // Written by the draining thread only
+      std::atomic<size_t> tail = 0;
+      std::atomic<size_t> dropped = 0;
+      size_t reportedDropped = 0;
+      // Cleared when the producing thread exits so the ring can be reused
+      std::atomic<bool> owned = true;
+    };
+
+    struct QueuedMessage {
+      uint64_t sequence;
+      LogTime time;
+      LogLevel level;
+      std::string text;
+    };
+
+    // Releases the calling thread's ring on thread exit
+    struct ThreadRing {
+      LogRing* pRing = nullptr;
+
+      ~ThreadRing() {
+        if (pRing) {
+          pRing->owned.store(false, std::memory_order_release);
+        }
+      }
+    };
+    thread_local ThreadRing tlsRing;
+
+    template<typename Mutex>
+    bool tryLockFor(Mutex& mutex, const std::chrono::milliseconds timeout) {
+      const auto deadline = std::chrono::steady_clock::now() + timeout;
+      while (!mutex.try_lock()) {
+        if (std::chrono::steady_clock::now() >= deadline) {
+          return false;
+        }
+        std::this_thread::yield();
+      }
+      return true;
+    }
+  }
+
+  struct Logger::AsyncState {
+    std::mutex ringsMutex;
+    std::vector<std::unique_ptr<LogRing>> rings;
+    std::atomic<uint64_t> sequence = 0;
+
+    // Held by whichever thread consumes the rings and writes out their messages
+    std::mutex drainMutex;
+
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+    std::atomic<bool> running = true;
+    std::thread writer;
+
+    LogRing& threadRing() {
+      if (tlsRing.pRing == nullptr) {
+        std::scoped_lock lock(ringsMutex);
+        // Reuse a ring left behind by an exited thread if possible
+        for (auto& ring : rings) {
+          bool expected = false;
+          if (ring->owned.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+            tlsRing.pRing = ring.get();
+            break;
+          }
+        }
+        if (tlsRing.pRing == nullptr) {
+          rings.emplace_back(std::make_unique<LogRing>());
+          tlsRing.pRing = rings.back().get();
+        }
+      }
+      return *tlsRing.pRing;
+    }
+
+    void enqueue(const LogLevel level, const std::string& message) {
+      LogRing& ring = threadRing();
+      const size_t numRecords = std::max<size_t>(1, (message.size() + kRecordTextSize - 1) / kRecordTextSize);
+      const size_t head = ring.head.load(std::memory_order_relaxed);
+      const size_t tail = ring.tail.load(std::memory_order_acquire);
+      if (numRecords > kRingRecords - (head - tail)) {
+        ring.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+
+      const LogTime time = getLocalTime();
+      const uint64_t seq = sequence.fetch_add(1, std::memory_order_relaxed);
+      size_t offset = 0;
+      for (size_t i = 0; i < numRecords; i++) {
+        LogRecord& record = ring.records[(head + i) % kRingRecords];
+        const size_t length = std::min(kRecordTextSize, message.size() - offset);
+        record.sequence = seq;
+        record.time = time;
+        record.level = level;
+        record.length = (uint16_t) length;
+        record.continued = (i + 1) < numRecords;
+        memcpy(record.text, message.data() + offset, length);
+        offset += length;
+      }
+      ring.head.store(head + numRecords, std::memory_order_release);
+
+      if (level >= LogLevel::Error) {
+        wake.notify_one();
+      }
+    }
+
+    // Writes out all queued messages, called by the writer thread
+    void drain() {
+      std::scoped_lock lock(drainMutex);
+      drainLocked(true);
+    }
+
+    // Used on exit and crash paths, where the writer may be alive or may have been
+    // terminated while holding a lock. The queued messages are only written if the rings
+    // can be taken over in time, they are never consumed alongside a live writer.
+    void tryDrain() {
+      std::unique_lock lock(drainMutex, std::defer_lock);
+      if (tryLockFor(lock, kFlushLockTimeout)) {
+        drainLocked(false);
+      }
+    }
+
+    void stop() {
+      running.store(false, std::memory_order_release);
+      wake.notify_one();
+      if (writer.joinable()) {
+#ifdef _WIN32
+        // At process exit the writer may be stuck behind the loader lock on its way out,
+        // so the join is bounded. A writer that does not exit in time is left alone.
+        const auto timeout = (DWORD) kWriterStopTimeout.count();
+        if (WaitForSingleObject(writer.native_handle(), timeout) == WAIT_OBJECT_0) {
+          writer.join();
+        } else {
+          writer.detach();
+        }
+#else
+        writer.join();
+#endif
+      }
+      tryDrain();
+    }
+
+    // Only called with drainMutex held
+    void drainLocked(const bool wait) {
+      std::vector<QueuedMessage> messages;
+      if (!collect(messages, wait)) {
+        return;
+      }
+      std::sort(messages.begin(), messages.end(),
+                [](const QueuedMessage& a, const QueuedMessage& b) { return a.sequence < b.sequence; });
+      std::unique_lock lineLock(s_mutex, std::defer_lock);
+      acquire(lineLock, wait);
+      for (const auto& msg : messages) {
+        char timeString[64];
+        getTimeString(msg.time, timeString);
+        auto ss = formatMessage(msg.level, msg.text, timeString);
+        std::string line;
+        while (std::getline(ss, line, '\n')) {
+          logger->emitLine(msg.level, line);
+        }
+      }
+    }
+
+    template<typename Lock>
+    static bool acquire(Lock& lock, const bool wait) {
+      if (wait) {
+        lock.lock();
+        return true;
+      }
+      return tryLockFor(lock, kFlushLockTimeout);
+    }
+
+    // Moves all complete messages from the rings to the write out list. Fails if the
+    // ring list is locked by a thread that may be adding to it.
+    bool collect(std::vector<QueuedMessage>& messages, const bool wait) {
+      std::unique_lock lock(ringsMutex, std::defer_lock);
+      if (!acquire(lock, wait)) {
+        return false;
+      }
+      for (auto& ring : rings) {
+        const size_t head = ring->head.load(std::memory_order_acquire);
+        size_t tail = ring->tail.load(std::memory_order_relaxed);
+        while (tail != head) {
+          const LogRecord& first = ring->records[tail % kRingRecords];
+          QueuedMessage msg { first.sequence, first.time, first.level, {} };
+          const LogRecord* pRecord = &first;
+          while (true) {
+            msg.text.append(pRecord->text, pRecord->length);
+            ++tail;
+            if (!pRecord->continued) {
+              break;
+            }
+            pRecord = &ring->records[tail % kRingRecords];
+          }
+          messages.emplace_back(std::move(msg));
+        }
+        ring->tail.store(tail, std::memory_order_release);
+
+        const size_t dropped = ring->dropped.load(std::memory_order_relaxed);
+        if (dropped != ring->reportedDropped) {
+          messages.push_back({ sequence.fetch_add(1, std::memory_order_relaxed), getLocalTime(), LogLevel::Warn,
+                               format_string("%zu log messages dropped, logging thread outpaced the log writer",
+                                             dropped - ring->reportedDropped) });
+          ring->reportedDropped = dropped;
+        }
+      }
+      return true;
+    }
+  };
+
+  Logger::AsyncState* Logger::s_async = nullptr;
   Logger* Logger::logger = nullptr;
   Logger::PreInitMessageArr Logger::s_preInitMsgs;
   std::mutex Logger::s_mutex;
@@ -70,6 +329,29 @@ namespace bridge_util {
     if (logger == nullptr) {
       logger = new Logger(GlobalOptions::getLogLevel());
       emitPreInitMsgs();
+
+      if (GlobalOptions::getAsyncLogging() && logger->m_level != LogLevel::None) {
+        s_async = new AsyncState;
+        s_async->writer = std::thread([]() {
+          while (s_async->running.load(std::memory_order_acquire)) {
+            {
+              std::unique_lock lock(s_async->wakeMutex);
+              s_async->wake.wait_for(lock, kWriterInterval);
+            }
+            s_async->drain();
+          }
+        });
+        // Stop the writer before writing out what is left
+        std::atexit([]() {
+          s_async->stop();
+        });
+      }
+    }
+  }
+
+  void Logger::flush() {
+    if (s_async) {
+      s_async->tryDrain();
     }
   }
 
@@ -150,6 +432,7 @@ namespace bridge_util {
 
   void Logger::errLogMessageBoxAndExit(const std::string& message) {
     Logger::err(message);
+    flush();
     MessageBox(nullptr, message.c_str(), logger_strings::RtxRemixRuntimeError, MB_OK | MB_TOPMOST | MB_TASKMODAL);
     std::exit(-1 );
   }
@@ -159,6 +442,8 @@ namespace bridge_util {
   }
 
   void Logger::logLine(const LogLevel level, const char* line) {
+    // Used on crash paths, write out queued messages first to keep the log in order
+    flush();
     get().emitLine(level, line);
   }
 
@@ -168,6 +453,13 @@ namespace bridge_util {
       std::scoped_lock lock(s_mutex);
       s_preInitMsgs[(size_t)level] << ss.str();
     } else {
+      if (level < logger->m_level) {
+        return;
+      }
+      if (s_async) {
+        s_async->enqueue(level, message);
+        return;
+      }
       auto ss = formatMessage(level, message);
       std::scoped_lock lock(s_mutex);
       std::string line;
@@ -197,6 +489,13 @@ namespace bridge_util {
   }
   
   std::stringstream Logger::formatMessage(const LogLevel level, const std::string& message) {
+    char timeString[64];
+    getLocalTimeString(timeString);
+    return formatMessage(level, message, timeString);
+  }
+
+  std::stringstream Logger::formatMessage(const LogLevel level, const std::string& message,
+                                          const char* timeString) {
     std::stringstream unformattedStream(message);
     std::string       line;
     static std::array<const char*, 5> s_prefixes = { { "trace: ",
@@ -205,8 +504,6 @@ namespace bridge_util {
                                                         "warn:  ",
                                                         "err:   " } };
     const char* prefix = s_prefixes.at(static_cast<uint32_t>(level));
-    char timeString[64];
-    getLocalTimeString(timeString);
 
     std::stringstream formattedStream;
     while (std::getline(unformattedStream, line, '\n')) {
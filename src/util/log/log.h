@@ -65,7 +65,14 @@ namespace bridge_util {
 
     static void set_loglevel(const LogLevel level);
 
+    // Writes out all messages queued by the asynchronous backend. Also used on
+    // crash and exit paths, so it does not wait indefinitely for the writer.
+    static void flush();
+
   private:
+    struct AsyncState;
+    static AsyncState* s_async;
+
     static Logger* logger;
     using PreInitMessageArr = std::array<std::stringstream, (size_t)LogLevel::None>;
     static PreInitMessageArr s_preInitMsgs;
@@ -87,6 +94,8 @@ namespace bridge_util {
     static void emitMsg(const LogLevel level, const std::string& message);
     void emitLine(const LogLevel level, const std::string& line);
     static std::stringstream formatMessage(const LogLevel level, const std::string& message);
+    static std::stringstream formatMessage(const LogLevel level, const std::string& message,
+                                           const char* timeString);
   };
 
   static LogLevel str_to_loglevel(const std::string& strLogLevel) {
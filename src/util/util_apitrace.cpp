@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#include "util_apitrace.h"
+#include "util_filesys.h"
+
+#include "config/global_options.h"
+#include "log/log.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <intrin.h>
+#include <windows.h>
+
+namespace bridge_util {
+
+  namespace {
+    constexpr size_t kRingRecords = 16384;
+    constexpr size_t kRingMask = kRingRecords - 1;
+    static_assert((kRingRecords & kRingMask) == 0, "Ring size must be a power of two");
+    // How long dump() waits for the ring list lock on a crash
+    constexpr auto kDumpLockTimeout = std::chrono::milliseconds(100);
+
+    struct TraceRing {
+      std::array<ApiTrace::Record, kRingRecords> records;
+      // Number of records ever written, only advanced by the owning thread
+      std::atomic<uint64_t> head = 0;
+      uint32_t threadId = 0;
+      // Cleared when the owning thread exits so the ring can be reused. The
+      // records of the previous owner stay in the ring until overwritten.
+      std::atomic<bool> owned = true;
+    };
+
+    // Releases the calling thread's ring on thread exit
+    struct ThreadRing {
+      TraceRing* pRing = nullptr;
+
+      ~ThreadRing() {
+        if (pRing) {
+          pRing->owned.store(false, std::memory_order_release);
+        }
+      }
+    };
+
+    std::mutex gRingsMutex;
+    std::vector<std::unique_ptr<TraceRing>> gRings;
+    thread_local ThreadRing tlsRing;
+
+    // The timestamp counter is calibrated against QPC between init() and dump()
+    uint64_t gTscStart = 0;
+    LARGE_INTEGER gQpcStart = {};
+
+    TraceRing& threadRing() {
+      if (tlsRing.pRing == nullptr) {
+        std::scoped_lock lock(gRingsMutex);
+        // Reuse a ring left behind by an exited thread if possible, so that games
+        // churning through threads don't keep adding rings
+        for (auto& ring : gRings) {
+          bool expected = false;
+          if (ring->owned.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+            tlsRing.pRing = ring.get();
+            break;
+          }
+        }
+        if (tlsRing.pRing == nullptr) {
+          gRings.emplace_back(std::make_unique<TraceRing>());
+          tlsRing.pRing = gRings.back().get();
+        }
+        tlsRing.pRing->threadId = GetCurrentThreadId();
+      }
+      return *tlsRing.pRing;
+    }
+
+    uint64_t getTscFrequency() {
+      LARGE_INTEGER qpcNow, qpcFreq;
+      const uint64_t tscNow = __rdtsc();
+      QueryPerformanceCounter(&qpcNow);
+      QueryPerformanceFrequency(&qpcFreq);
+      const uint64_t qpcTicks = (uint64_t) (qpcNow.QuadPart - gQpcStart.QuadPart);
+      if (qpcTicks == 0) {
+        return 0;
+      }
+      const double seconds = (double) qpcTicks / (double) qpcFreq.QuadPart;
+      return (uint64_t) ((double) (tscNow - gTscStart) / seconds);
+    }
+  }
+
+  std::atomic<bool> ApiTrace::s_enabled = false;
+
+  void ApiTrace::init() {
+    gTscStart = __rdtsc();
+    QueryPerformanceCounter(&gQpcStart);
+    setEnabled(GlobalOptions::getApiTrace());
+    std::atexit([]() { dump(); });
+  }
+
+  void ApiTrace::recordImpl(const Event event, const uint16_t command, const uint16_t flags,
+                            const uint32_t handle, const uint32_t arg0, const uint32_t arg1) {
+    TraceRing& ring = threadRing();
+    const uint64_t head = ring.head.load(std::memory_order_relaxed);
+    Record& record = ring.records[head & kRingMask];
+    record.timestamp = __rdtsc();
+    record.threadId = ring.threadId;
+    record.handle = handle;
+    record.command = command;
+    record.flags = flags;
+    record.event = event;
+    record.args[0] = arg0;
+    record.args[1] = arg1;
+    ring.head.store(head + 1, std::memory_order_release);
+  }
+
+  void ApiTrace::dump() {
+    // On a crash the lock may be held by a thread that is gone, carry on without it
+    std::unique_lock lock(gRingsMutex, std::defer_lock);
+    const auto deadline = std::chrono::steady_clock::now() + kDumpLockTimeout;
+    while (!lock.try_lock() && std::chrono::steady_clock::now() < deadline) {
+      std::this_thread::yield();
+    }
+
+    std::vector<Record> records;
+    for (const auto& ring : gRings) {
+      const uint64_t head = ring->head.load(std::memory_order_acquire);
+      const uint64_t count = std::min<uint64_t>(head, kRingRecords);
+      for (uint64_t i = head - count; i < head; i++) {
+        records.push_back(ring->records[i & kRingMask]);
+      }
+    }
+    if (records.empty()) {
+      return;
+    }
+    std::sort(records.begin(), records.end(),
+              [](const Record& a, const Record& b) { return a.timestamp < b.timestamp; });
+
+#ifdef REMIX_BRIDGE_CLIENT
+    const char* traceName = "bridge32.trace";
+#else
+    const char* traceName = "bridge64.trace";
+#endif
+    const auto tracePath = RtxFileSys::path(RtxFileSys::Logs) / traceName;
+    FILE* pFile = nullptr;
+    if (fopen_s(&pFile, tracePath.string().c_str(), "wb") != 0 || pFile == nullptr) {
+      Logger::err(format_string("Unable to write API trace to %s", tracePath.string().c_str()));
+      return;
+    }
+
+    FileHeader header;
+    std::copy(std::begin(kMagic), std::end(kMagic), header.magic);
+    header.version = kVersion;
+    header.frequency = getTscFrequency();
+    header.numRecords = (uint32_t) records.size();
+    header.pointerBits = sizeof(void*) * 8;
+    fwrite(&header, sizeof(header), 1, pFile);
+    fwrite(records.data(), sizeof(Record), records.size(), pFile);
+    fclose(pFile);
+
+    Logger::info(format_string("API trace with %zu records written to %s",
+                               records.size(), tracePath.string().c_str()));
+  }
+
+}
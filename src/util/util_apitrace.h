@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace bridge_util {
+
+  // Binary trace of the commands passing through the bridge. Each thread appends
+  // fixed size records to its own ring, which keeps the most recent records and
+  // overwrites the oldest ones. Recording can be switched on and off at any time,
+  // and the rings are dumped to a file at exit or on a crash. The file is decoded
+  // with the NvRemixBridgeTraceDecoder tool.
+  class ApiTrace {
+  public:
+    enum class Event : uint8_t {
+      // A command was pushed to a command queue. args: UID, data offset
+      Send = 0,
+      // The server started processing a device command. args: UID, data offset
+      Execute = 1
+    };
+
+    struct Record {
+      uint64_t timestamp;
+      uint32_t threadId;
+      uint32_t handle;
+      uint16_t command;
+      uint16_t flags;
+      Event event;
+      uint8_t reserved[3];
+      uint32_t args[2];
+    };
+    static_assert(sizeof(Record) == 32);
+
+    static constexpr char kMagic[4] = { 'B', 'R', 'T', 'R' };
+    static constexpr uint32_t kVersion = 1;
+
+    struct FileHeader {
+      char magic[4];
+      uint32_t version;
+      // Timestamp ticks per second
+      uint64_t frequency;
+      uint32_t numRecords;
+      // 32 for the client, 64 for the server
+      uint32_t pointerBits;
+    };
+
+    // Reads the initial state from the apiTrace option and sets up the dump at exit
+    static void init();
+
+    static bool isEnabled() {
+      return s_enabled.load(std::memory_order_relaxed);
+    }
+
+    static void setEnabled(const bool enabled) {
+      s_enabled.store(enabled, std::memory_order_relaxed);
+    }
+
+    static inline void record(const Event event, const uint16_t command, const uint16_t flags,
+                              const uint32_t handle, const uint32_t arg0, const uint32_t arg1) {
+      if (isEnabled()) {
+        recordImpl(event, command, flags, handle, arg0, arg1);
+      }
+    }
+
+    // Writes all rings to the trace file in the log folder, ordered by time
+    static void dump();
+
+  private:
+    static std::atomic<bool> s_enabled;
+
+    static void recordImpl(const Event event, const uint16_t command, const uint16_t flags,
+                           const uint32_t handle, const uint32_t arg0, const uint32_t arg1);
+  };
+
+}
@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+
+#include <assert.h>
+#include <stdint.h>
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+namespace bridge_util {
+
+// A bump allocator backing the variable length members of deserialized
+// Serializable<T> structs. While a Scope is alive on a thread, deserializing
+// carves memory out of that thread's arena instead of new'ing it, and the
+// Serializable skips its _dtor(). POD arrays are not copied at all but point
+// straight into the buffer being deserialized from. Everything is released
+// at once when the Scope ends, so neither the deserialized structs nor the
+// source buffer may go away before it.
+class DeserializeArena {
+public:
+  static constexpr size_t kDefaultBlockSize = 64 * 1024;
+
+  // Nested scopes share the outermost one, which does the reset
+  class Scope {
+  public:
+    Scope() : m_bOwner(s_pCurrent == nullptr) {
+      if (m_bOwner) {
+        s_pCurrent = &threadArena();
+      }
+    }
+    ~Scope() {
+      if (m_bOwner) {
+        s_pCurrent->reset();
+        s_pCurrent = nullptr;
+      }
+    }
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+  private:
+    const bool m_bOwner;
+  };
+
+  static DeserializeArena* current() {
+    return s_pCurrent;
+  }
+
+  void* allocate(const size_t size, const size_t alignment) {
+    assert((alignment & (alignment - 1)) == 0);
+    if (!m_blocks.empty()) {
+      const auto base = reinterpret_cast<uintptr_t>(m_blocks.back().data.get());
+      const size_t offset = align(base + m_offset, alignment) - base;
+      if (offset + size <= m_blocks.back().size) {
+        m_offset = offset + size;
+        return m_blocks.back().data.get() + offset;
+      }
+    }
+    const size_t blockSize = std::max(kDefaultBlockSize, size + alignment);
+    m_blocks.push_back({ std::make_unique<uint8_t[]>(blockSize), blockSize });
+    m_used += m_offset;
+    const auto base = reinterpret_cast<uintptr_t>(m_blocks.back().data.get());
+    const size_t offset = align(base, alignment) - base;
+    m_offset = offset + size;
+    return m_blocks.back().data.get() + offset;
+  }
+
+  template<typename T>
+  T* allocate(const size_t num) {
+    return static_cast<T*>(allocate(num * sizeof(T), alignof(T)));
+  }
+
+  // Keeps a single block large enough for everything the last scope used,
+  // so that steady state deserialization does not allocate at all
+  void reset() {
+    if (m_blocks.size() > 1) {
+      size_t total = m_used + m_offset;
+      for (const auto& block : m_blocks) {
+        total = std::max(total, block.size);
+      }
+      m_blocks.clear();
+      m_blocks.push_back({ std::make_unique<uint8_t[]>(total), total });
+    }
+    m_offset = 0;
+    m_used = 0;
+  }
+
+private:
+  struct Block {
+    std::unique_ptr<uint8_t[]> data;
+    size_t size;
+  };
+
+  static uintptr_t align(const uintptr_t p, const size_t alignment) {
+    return (p + alignment - 1) & ~(uintptr_t) (alignment - 1);
+  }
+
+  static DeserializeArena& threadArena() {
+    static thread_local DeserializeArena arena;
+    return arena;
+  }
+
+  std::vector<Block> m_blocks;
+  size_t m_offset = 0;
+  size_t m_used = 0;
+  static inline thread_local DeserializeArena* s_pCurrent = nullptr;
+};
+
+}
@@ -179,6 +179,14 @@ namespace bridge_util {
       return currentWrite == m_read->load(std::memory_order_acquire);
     }
 
+    // Number of elements pushed but not yet pulled. Only a snapshot, since
+    // the other side may advance its index at any time.
+    size_t getOccupancy() const {
+      const auto pushed = m_read->load(std::memory_order_acquire);
+      const auto pulled = m_write->load(std::memory_order_acquire);
+      return (pushed + m_queueSize - pulled) % m_queueSize;
+    }
+
     std::vector<Commands::D3D9Command> buildQueueData(int maxQueueElements, int currentIndex) {
       std::vector<Commands::D3D9Command> commandHistory;
       int itemCount = 0;
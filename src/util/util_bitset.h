@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace bridge_util {
+
+  // Fixed size set of bits packed into 32-bit words. Unlike std::bitset it exposes
+  // the words and visits set bits using count-trailing-zeros, so sparse sets are
+  // walked in time proportional to the number of set bits.
+  template<size_t N>
+  class BitSet {
+  public:
+    static constexpr size_t kBitsPerWord = 32;
+    static constexpr size_t kNumWords = (N + kBitsPerWord - 1) / kBitsPerWord;
+
+    class Reference {
+      friend class BitSet;
+      uint32_t& m_word;
+      const uint32_t m_mask;
+
+      Reference(uint32_t& word, const uint32_t mask)
+        : m_word(word)
+        , m_mask(mask) {
+      }
+    public:
+      Reference& operator=(const bool value) {
+        if (value) {
+          m_word |= m_mask;
+        } else {
+          m_word &= ~m_mask;
+        }
+        return *this;
+      }
+
+      operator bool() const {
+        return (m_word & m_mask) != 0;
+      }
+    };
+
+    static constexpr size_t size() {
+      return N;
+    }
+
+    Reference operator[](const size_t idx) {
+      assert(idx < N);
+      return Reference(m_words[idx / kBitsPerWord], bitMask(idx));
+    }
+
+    bool operator[](const size_t idx) const {
+      return test(idx);
+    }
+
+    bool test(const size_t idx) const {
+      assert(idx < N);
+      return (m_words[idx / kBitsPerWord] & bitMask(idx)) != 0;
+    }
+
+    // Sets all bits
+    void set() {
+      for (size_t w = 0; w < kNumWords; w++) {
+        m_words[w] = ~0u;
+      }
+      clearPadding();
+    }
+
+    // Sets count bits starting at first, a word at a time
+    void setRange(const size_t first, const size_t count) {
+      assert(first + count <= N);
+      size_t idx = first;
+      const size_t end = first + count;
+      while (idx < end) {
+        const size_t bit = idx % kBitsPerWord;
+        const size_t numBits = (end - idx) < (kBitsPerWord - bit) ? (end - idx) : (kBitsPerWord - bit);
+        const uint32_t mask = numBits == kBitsPerWord ? ~0u : (((1u << numBits) - 1u) << bit);
+        m_words[idx / kBitsPerWord] |= mask;
+        idx += numBits;
+      }
+    }
+
+    void reset() {
+      m_words.fill(0);
+    }
+
+    bool any() const {
+      for (size_t w = 0; w < kNumWords; w++) {
+        if (m_words[w]) {
+          return true;
+        }
+      }
+      return false;
+    }
+
+    uint32_t word(const size_t w) const {
+      return m_words[w];
+    }
+
+    // Calls fn(index) for every set bit in ascending order
+    template<typename Fn>
+    void forEachSet(Fn&& fn) const {
+      for (size_t w = 0; w < kNumWords; w++) {
+        uint32_t bits = m_words[w];
+        while (bits) {
+          fn(w * kBitsPerWord + countTrailingZeros(bits));
+          bits &= bits - 1;
+        }
+      }
+    }
+
+  private:
+    std::array<uint32_t, kNumWords> m_words = {};
+
+    static uint32_t bitMask(const size_t idx) {
+      return 1u << (idx % kBitsPerWord);
+    }
+
+    static uint32_t countTrailingZeros(const uint32_t bits) {
+#ifdef _MSC_VER
+      unsigned long idx;
+      _BitScanForward(&idx, bits);
+      return idx;
+#else
+      return (uint32_t) __builtin_ctz(bits);
+#endif
+    }
+
+    void clearPadding() {
+      if constexpr ((N % kBitsPerWord) != 0) {
+        m_words[kNumWords - 1] &= (1u << (N % kBitsPerWord)) - 1u;
+      }
+    }
+  };
+
+}
@@ -20,6 +20,9 @@
  * DEALINGS IN THE SOFTWARE.
  */
 #include "util_bridgecommand.h"
+#include "util_apitrace.h"
+#include "util_metrics.h"
+#include "util_profiling.h"
 #include "log/log_strings.h"
 
 namespace {
@@ -55,6 +58,11 @@ DECL_BRIDGE_FUNC(void, init,
   bIsInit = true;
 }
 
+template<typename BridgeId>
+static constexpr Metrics::Channel metricsChannel() {
+  return std::is_same_v<BridgeId, ::BridgeId::Module> ? Metrics::Channel::Module : Metrics::Channel::Device;
+}
+
 DECL_BRIDGE_FUNC(void, syncDataQueue, size_t expectedMemUsage, bool posResetOnLastIndex) {
   int serverCount = *s_pWriterChannel->serverDataPos;
   size_t currClientDataPos = s_pWriterChannel->get_data_pos();
@@ -62,6 +70,7 @@ DECL_BRIDGE_FUNC(void, syncDataQueue, size_t expectedMemUsage, bool posResetOnLa
   size_t totalSize = s_pWriterChannel->data->get_total_size();
 
   auto handleOverwriteCondition = [&]() {
+    Metrics::addOverwriteStall(metricsChannel<BridgeId>());
     // Below variable is set to let the server know that a particular position
     // in the queue not yet accessed by it is going to be used
     *s_pWriterChannel->clientDataExpectedPos = s_curBatchStartPos - 1;
@@ -312,13 +321,15 @@ DECL_COMMAND_FUNC(,~Command) {
   // Only actually send the command if the bridge is enabled, otherwise this becomes a no-op
   if (gbBridgeRunning) {
     s_pWriterChannel->data->end_batch();
+    const int32_t batchStartPos = s_curBatchStartPos;
     s_curBatchStartPos = -1;
     uint32_t numRetries = 0;
     Result result;
+    const uint32_t dataOffset = (uint32_t) s_pWriterChannel->data->get_pos();
     // We check if the bridge is enabled for each loop iteration in case it
     // was disabled externally by the server process exit callback.
     do {
-      result = s_pWriterChannel->commands->push({ m_command, m_commandFlags, (uint32_t) s_pWriterChannel->data->get_pos(), m_handle });
+      result = s_pWriterChannel->commands->push({ m_command, m_commandFlags, dataOffset, m_handle });
 #if defined(_DEBUG) || defined(DEBUGOPT)
       if (GlobalOptions::getLogAllCommands()) {
         Logger::info("Pushed: " + toString(m_command));
@@ -332,6 +343,26 @@ DECL_COMMAND_FUNC(,~Command) {
       && BridgeState::getServerState_NoLock() == BridgeState::ProcessState::Running
 #endif
     );
+    ApiTrace::record(ApiTrace::Event::Send, m_command, m_commandFlags, m_handle,
+                     (uint32_t) s_cmdUID, dataOffset);
+#ifdef TRACY_ENABLE
+    if (std::is_same_v<BridgeId, ::BridgeId::Device> && *s_pWriterChannel->serverDataPos >= 0) {
+      const size_t totalSize = s_pWriterChannel->data->get_total_size();
+      const size_t pending = (dataOffset + totalSize - (size_t) *s_pWriterChannel->serverDataPos) % totalSize;
+      TracyPlot(PlotNames::DataQueueOccupancy, (int64_t) (pending * sizeof(DataT)));
+    }
+#endif
+    if (Metrics::isEnabled()) {
+      // Count the command header plus everything written to the data queue for it
+      const size_t totalSize = s_pWriterChannel->data->get_total_size();
+      const size_t dataSize = (dataOffset + totalSize - batchStartPos) % totalSize;
+      Metrics::addCommand(metricsChannel<BridgeId>(), sizeof(Header) + dataSize * sizeof(DataT), numRetries);
+      const int64_t readerPos = *s_pWriterChannel->serverDataPos;
+      if (readerPos >= 0) {
+        const size_t pending = (dataOffset + totalSize - (size_t) readerPos) % totalSize;
+        Metrics::updateDataQueueOccupancy(metricsChannel<BridgeId>(), pending * sizeof(DataT));
+      }
+    }
 #ifdef REMIX_BRIDGE_CLIENT
     if (BridgeState::getServerState_NoLock() >= BridgeState::ProcessState::DoneProcessing) {
       Logger::warn(format_string("The command %s will not be sent; Server is in the process of or has already shut down. Turning bridge off.", Commands::toString(m_command).c_str()));
@@ -353,5 +384,63 @@ DECL_COMMAND_FUNC(,~Command) {
 #endif
 }
 
+DECL_BRIDGE_FUNC(typename Bridge<BridgeId>::StreamId, send_stream_if_oversized, const size_t size, const void* pData) {
+  if (!needs_streaming(size) || pData == nullptr) {
+    return kNoStream;
+  }
+  ZoneScoped;
+  StreamId id = s_nextStreamId.fetch_add(1, std::memory_order_relaxed);
+  if (id == kNoStream) {
+    id = s_nextStreamId.fetch_add(1, std::memory_order_relaxed);
+  }
+  // Small enough that several chunks are in flight at once, so the reader
+  // consumes one while the next is being written
+  const size_t chunkSize = get_stream_threshold() / 2;
+  const uint8_t* const pBytes = static_cast<const uint8_t*>(pData);
+  for (size_t offset = 0; offset < size && gbBridgeRunning; offset += chunkSize) {
+    const size_t thisChunkSize = std::min(chunkSize, size - offset);
+    Command c(Commands::Bridge_DataStreamChunk, id);
+    c.send_many((DataT) offset, (DataT) size);
+    if (auto* const pChunk = c.begin_data_blob(thisChunkSize)) {
+      memcpy(pChunk, pBytes + offset, thisChunkSize);
+      c.end_data_blob();
+    }
+  }
+  return id;
+}
+
+DECL_BRIDGE_FUNC(void, receive_stream_chunk, const StreamId id) {
+  const DataT offset = get_data();
+  const DataT size = get_data();
+  void* pChunk = nullptr;
+  const DataT chunkSize = get_data(&pChunk);
+  auto& stream = s_pendingStreams[id];
+  if (offset == 0) {
+    // Streams arrive strictly after the commands consuming earlier ones
+    // have been processed, so those are done with their payloads by now
+    s_consumedStreams.clear();
+    stream.data.resize(size);
+    stream.size = size;
+  }
+  assert(stream.size == size && offset + chunkSize <= size);
+  if (pChunk && offset + chunkSize <= stream.data.size()) {
+    memcpy(stream.data.data() + offset, pChunk, chunkSize);
+  }
+}
+
+DECL_BRIDGE_FUNC(const typename Bridge<BridgeId>::DataT&, consume_stream, const StreamId id, void** obj) {
+  const auto it = s_pendingStreams.find(id);
+  if (it == s_pendingStreams.end()) {
+    Logger::err(format_string("DataQueue: Streamed payload %u was never received!", id));
+    s_consumedStreams.emplace_back();
+    *obj = nullptr;
+    return s_consumedStreams.back().size;
+  }
+  s_consumedStreams.push_back(std::move(it->second));
+  s_pendingStreams.erase(it);
+  *obj = s_consumedStreams.back().data.data();
+  return s_consumedStreams.back().size;
+}
+
 template class Bridge<BridgeId::Module>;
 template class Bridge<BridgeId::Device>;
\ No newline at end of file
@@ -31,6 +31,11 @@
 #include "util_singleton.h"
 #include "../tracy/tracy.hpp"
 
+#include <atomic>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
 extern bool gbBridgeRunning;
 
 #define WAIT_FOR_SERVER_RESPONSE(func, value, uidVal) \
@@ -139,6 +144,11 @@ public:
 
   static inline const DataT& get_data(void** obj) {
     ZoneScoped;
+    // A streamed payload was reassembled ahead of this command
+    if (getReaderChannel().data->peek() == kStreamedDataSize) {
+      get_data();
+      return consume_stream((StreamId) get_data(), obj);
+    }
     size_t prevPos = get_data_pos();
     const Bridge::DataT& retval = getReaderChannel().data->pull(obj);
     // Check if the server completed a loop
@@ -190,6 +200,32 @@ public:
     return 0;
   }
 
+  //=============================//
+  // Oversized payload streaming //
+  //=============================//
+  // Payloads too large for a command's data batch are sent ahead of the
+  // command as a series of Bridge_DataStreamChunk commands, each small enough
+  // to be consumed while the next one is written. The reader reassembles
+  // them and hands the whole payload out when the command pulls it with
+  // get_data(void**), so the consuming side needs no changes.
+  using StreamId = uint32_t;
+  static constexpr StreamId kNoStream = 0;
+  // Pushed in place of a payload size, followed by the stream id
+  static constexpr DataT kStreamedDataSize = (DataT) -1;
+
+  static inline size_t get_stream_threshold() {
+    return getWriterChannel().data->get_total_size() * sizeof(DataT) / 4;
+  }
+  static inline bool needs_streaming(const size_t size) {
+    return gbBridgeRunning && size > get_stream_threshold();
+  }
+  // Streams the payload if needs_streaming(), returns kNoStream otherwise.
+  // Must not be called while a Command is alive. The command consuming the
+  // payload then uses Command::send_data_or_stream() with the returned id.
+  static StreamId send_stream_if_oversized(const size_t size, const void* pData);
+  // Handles a Bridge_DataStreamChunk on the reader side
+  static void receive_stream_chunk(const StreamId id);
+
   static Header pop_front();
   static void syncDataQueue(size_t expectedMemUsage, bool posResetOnLastIndex = false);
   static bridge_util::Result ensureQueueEmpty();
@@ -267,6 +303,15 @@ public:
       }
     }
 
+    // Sends a payload, or the reference to it if it was streamed ahead
+    inline void send_data_or_stream(const StreamId streamId, const DataT size, const void* obj) {
+      if (streamId == kNoStream) {
+        send_data(size, obj);
+      } else {
+        send_many(kStreamedDataSize, streamId);
+      }
+    }
+
     inline uint8_t* begin_data_blob(const size_t size) {
       ZoneScoped;
       uint8_t* blobPacketPtr = nullptr;
@@ -343,6 +388,18 @@ private:
   static inline size_t         s_cmdCounter = 0;
   // UIDs are assigned to commands to tag the responses from server to allow misorder responses to be handled correctly 
   static inline UID s_cmdUID = 0;
+  // Streaming state, ids are allocated by the writer and payloads are
+  // reassembled by the reader
+  struct Stream {
+    std::vector<uint8_t> data;
+    DataT size = 0;
+  };
+  static inline std::atomic<StreamId> s_nextStreamId = 1;
+  static inline std::unordered_map<StreamId, Stream> s_pendingStreams;
+  // Streams handed out to the command being processed. A deque so that the
+  // references returned by get_data(void**) stay valid while it grows.
+  static inline std::deque<Stream> s_consumedStreams;
+  static const DataT& consume_stream(const StreamId id, void** obj);
 #if defined(REMIX_BRIDGE_CLIENT)
   static constexpr char kWriterChannelName[] = "Client2Server";
   static constexpr char kReaderChannelName[] = "Server2Client";
@@ -43,6 +43,7 @@ namespace Commands {
     RemixApi_CreateMesh,
     RemixApi_DestroyMesh,
     RemixApi_DrawInstance,
+    RemixApi_DrawInstanceBatch,
     RemixApi_CreateLight,
     RemixApi_DestroyLight,
     RemixApi_DrawLightInstance,
@@ -54,6 +55,10 @@ namespace Commands {
     Bridge_SharedHeap_Alloc,
     Bridge_SharedHeap_Dealloc,
 
+    // A piece of a payload too large for the data queue, streamed ahead of
+    // the command consuming it
+    Bridge_DataStreamChunk,
+
     // Unlink x86 d3d9 resource from x64 counterpart to prevent hash
     // collisions at server side. The resource must be properly
     // desposed of, or known to be released before the unlink to
@@ -443,6 +448,9 @@ namespace Commands {
     IDirect3DQuery9_GetDataSize,
     IDirect3DQuery9_Issue,
     IDirect3DQuery9_GetData,
+
+    // Number of contiguous command ids, must stay last
+    Bridge_CommandCount
   };
 
   // Maybe this will be useful...  
@@ -465,7 +473,7 @@ namespace Commands {
     kIDirect3DQuery9 = IDirect3DQuery9_QueryInterface
   };
 
-  inline static std::string toString(const D3D9Command& command) {
+  constexpr const char* toCString(const D3D9Command& command) {
     switch (command) {
     case Bridge_Terminate: return "Terminate";
     case Bridge_Invalid: return "Invalid";
@@ -481,6 +489,7 @@ namespace Commands {
     case RemixApi_CreateMesh: return "RemixApi_CreateMesh";
     case RemixApi_DestroyMesh: return "RemixApi_DestroyMesh";
     case RemixApi_DrawInstance: return "RemixApi_DrawInstance";
+    case RemixApi_DrawInstanceBatch: return "RemixApi_DrawInstanceBatch";
     case RemixApi_CreateLight: return "RemixApi_CreateLight";
     case RemixApi_DestroyLight: return "RemixApi_DestroyLight";
     case RemixApi_DrawLightInstance: return "DrawLightInstance";
@@ -491,6 +500,8 @@ namespace Commands {
     case Bridge_SharedHeap_AddSeg: return "SharedHeap_AddSeg";
     case Bridge_SharedHeap_Alloc: return "SharedHeap_Alloc";
     case Bridge_SharedHeap_Dealloc: return "SharedHeap_Dealloc";
+
+    case Bridge_DataStreamChunk: return "Bridge_DataStreamChunk";
     
     case Bridge_UnlinkResource: return "Bridge_UnlinkResource";
     case Bridge_UnlinkVolumeResource: return "Bridge_UnlinkVolumeResource";
@@ -865,6 +876,10 @@ namespace Commands {
     }
   }
 
+  inline static std::string toString(const D3D9Command& command) {
+    return toCString(command);
+  }
+
   typedef uint16_t Flags;
 
   enum FlagBits: Flags {
@@ -872,6 +887,8 @@ namespace Commands {
                                     // and only allocation id(s) is transferred on the queue
     DataIsReserved   = 0b00000010,  // Data was already reserved in data queue and only its
                                     // offset is transferred
+    DataHasFence     = 0b00000100,  // A SharedHeap fence follows the allocation id and must be
+                                    // signaled once the data has been consumed
   };
 
   inline bool IsDataInSharedHeap(Flags flags) {
@@ -881,6 +898,10 @@ namespace Commands {
   inline bool IsDataReserved(Flags flags) {
     return (flags & FlagBits::DataIsReserved) != 0;
   }
+
+  inline bool IsDataFenced(Flags flags) {
+    return (flags & FlagBits::DataHasFence) != 0;
+  }
 }
 
 struct Header {
@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+
+#include "log/log.h"
+
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+
+namespace bridge_util {
+
+  // Layout of the object handles the client assigns to D3D objects. The low bits are
+  // a dense slot index, which is recycled after the object is destroyed. The high bits
+  // are a generation counter bumped on every reuse of the slot, so a stale handle never
+  // aliases the object that took over its slot. Generation 0 is never used, which keeps
+  // 0 free as the null handle.
+  namespace Handle {
+    static constexpr uint32_t kIndexBits = 22;
+    static constexpr uint32_t kGenerationBits = 32 - kIndexBits;
+    static constexpr uint32_t kMaxIndices = 1u << kIndexBits;
+    static constexpr uint32_t kIndexMask = kMaxIndices - 1;
+    static constexpr uint32_t kGenerationMask = (1u << kGenerationBits) - 1;
+
+    inline uint32_t index(const uint32_t handle) {
+      return handle & kIndexMask;
+    }
+
+    inline uint32_t generation(const uint32_t handle) {
+      return handle >> kIndexBits;
+    }
+
+    inline uint32_t make(const uint32_t index, const uint32_t generation) {
+      return (generation << kIndexBits) | index;
+    }
+
+    // True if handle a was issued after handle b for the same slot
+    inline bool isNewer(const uint32_t a, const uint32_t b) {
+      const uint32_t diff = (generation(a) - generation(b)) & kGenerationMask;
+      return diff != 0 && diff < (1u << (kGenerationBits - 1));
+    }
+  }
+
+  // Flat table mapping client handles to server objects, T being the object pointer
+  // type, e.g. HandleTable<IDirect3DDevice9*>. Slots are stored in lazily
+  // allocated fixed size pages indexed directly by the handle index, so lookups are a
+  // bounds-checked array load and references stay valid while the table grows.
+  // Mirrors the subset of the std::unordered_map interface used for handle maps.
+  template<typename T>
+  class HandleTable {
+    struct Slot {
+      uint32_t handle = 0;
+      T obj = nullptr;
+    };
+
+    static constexpr uint32_t kPageBits = 12;
+    static constexpr uint32_t kPageSize = 1u << kPageBits;
+    static constexpr uint32_t kPageMask = kPageSize - 1;
+    static constexpr uint32_t kNumPages = Handle::kMaxIndices / kPageSize;
+
+    std::array<std::unique_ptr<Slot[]>, kNumPages> m_pages;
+    // Returned for stale handles so that neither a lookup nor an assignment through
+    // a stale handle can reach the object now occupying the slot.
+    T m_stale = nullptr;
+
+    Slot& slot(const uint32_t handle) {
+      const uint32_t idx = Handle::index(handle);
+      auto& page = m_pages[idx >> kPageBits];
+      if (!page) {
+        page = std::make_unique<Slot[]>(kPageSize);
+      }
+      return page[idx & kPageMask];
+    }
+
+  public:
+    // Returns the object slot for the handle. A newer generation takes over the slot
+    // like an insertion into a map would, an older one is reported as stale.
+    T& operator[](const uint32_t handle) {
+      Slot& s = slot(handle);
+      if (s.handle != handle) {
+        if (s.obj != nullptr && !Handle::isNewer(handle, s.handle)) {
+          Logger::err(format_string("Stale handle %x used, slot is owned by handle %x.",
+                                    handle, s.handle));
+          assert(false && "Stale handle");
+          m_stale = nullptr;
+          return m_stale;
+        }
+        s.handle = handle;
+        s.obj = nullptr;
+      }
+      return s.obj;
+    }
+
+    void erase(const uint32_t handle) {
+      const auto& page = m_pages[Handle::index(handle) >> kPageBits];
+      if (page) {
+        Slot& s = page[Handle::index(handle) & kPageMask];
+        // The handle is kept so later uses of the erased handle resolve to null
+        if (s.handle == handle) {
+          s.obj = nullptr;
+        }
+      }
+    }
+
+    // Calls fn(handle, obj) for every mapped object
+    template<typename Fn>
+    void forEach(Fn&& fn) const {
+      for (const auto& page : m_pages) {
+        if (!page) {
+          continue;
+        }
+        for (uint32_t i = 0; i < kPageSize; i++) {
+          if (page[i].obj != nullptr) {
+            fn(page[i].handle, page[i].obj);
+          }
+        }
+      }
+    }
+
+    size_t size() const {
+      size_t count = 0;
+      forEach([&count](uint32_t, T) { ++count; });
+      return count;
+    }
+
+    bool empty() const {
+      return size() == 0;
+    }
+  };
+
+}
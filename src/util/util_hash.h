@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+namespace bridge_util {
+
+  // Fast non-cryptographic 64-bit hash used to detect changes in memory blocks and to
+  // identify shader bytecode. This is XXH64: every lane carries 64 bits of state and
+  // all lanes are folded into the whole result, so a change anywhere in the input is
+  // covered by the full 64 bits.
+  //
+  // The per-page checksums of static buffers use this scalar hash rather than a SIMD
+  // one. SSE2, the only vector ISA the 32-bit client can rely on, has no 64-bit
+  // multiply, and a lane-parallel SIMD hash with 32-bit multiplies would fold fewer
+  // bits per lane. The four independent lanes below already keep the pipeline busy,
+  // so a 4 KB page hashes at close to memory bandwidth.
+  class MemoryHash {
+    static constexpr uint64_t kPrime1 = 0x9E3779B185EBCA87ull;
+    static constexpr uint64_t kPrime2 = 0xC2B2AE3D27D4EB4Full;
+    static constexpr uint64_t kPrime3 = 0x165667B19E3779F9ull;
+    static constexpr uint64_t kPrime4 = 0x85EBCA77C2B2AE63ull;
+    static constexpr uint64_t kPrime5 = 0x27D4EB2F165667C5ull;
+
+    static inline uint64_t rotl(const uint64_t x, const int r) {
+      return (x << r) | (x >> (64 - r));
+    }
+
+    static inline uint64_t read64(const uint8_t* const p) {
+      uint64_t v;
+      memcpy(&v, p, sizeof(v));
+      return v;
+    }
+
+    static inline uint32_t read32(const uint8_t* const p) {
+      uint32_t v;
+      memcpy(&v, p, sizeof(v));
+      return v;
+    }
+
+    static inline uint64_t round(uint64_t acc, const uint64_t input) {
+      acc += input * kPrime2;
+      acc = rotl(acc, 31);
+      return acc * kPrime1;
+    }
+
+    static inline uint64_t mergeRound(uint64_t acc, const uint64_t lane) {
+      acc ^= round(0, lane);
+      return acc * kPrime1 + kPrime4;
+    }
+
+    static inline uint64_t avalanche(uint64_t h) {
+      h ^= h >> 33;
+      h *= kPrime2;
+      h ^= h >> 29;
+      h *= kPrime3;
+      h ^= h >> 32;
+      return h;
+    }
+
+  public:
+    static uint64_t hash(const void* const data, const size_t size, const uint64_t seed = 0) {
+      const uint8_t* p = static_cast<const uint8_t*>(data);
+      const uint8_t* const end = p + size;
+
+      uint64_t h;
+      if (size >= 32) {
+        uint64_t v1 = seed + kPrime1 + kPrime2;
+        uint64_t v2 = seed + kPrime2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - kPrime1;
+        for (; p + 32 <= end; p += 32) {
+          v1 = round(v1, read64(p));
+          v2 = round(v2, read64(p + 8));
+          v3 = round(v3, read64(p + 16));
+          v4 = round(v4, read64(p + 24));
+        }
+        h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        h = mergeRound(h, v1);
+        h = mergeRound(h, v2);
+        h = mergeRound(h, v3);
+        h = mergeRound(h, v4);
+      } else {
+        h = seed + kPrime5;
+      }
+      h += (uint64_t) size;
+
+      for (; p + 8 <= end; p += 8) {
+        h ^= round(0, read64(p));
+        h = rotl(h, 27) * kPrime1 + kPrime4;
+      }
+      if (p + 4 <= end) {
+        h ^= (uint64_t) read32(p) * kPrime1;
+        h = rotl(h, 23) * kPrime2 + kPrime3;
+        p += 4;
+      }
+      for (; p < end; ++p) {
+        h ^= (uint64_t) *p * kPrime5;
+        h = rotl(h, 11) * kPrime1;
+      }
+      return avalanche(h);
+    }
+  };
+}
@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#include "util_inputring.h"
+#include "util_semaphore.h"
+#include "util_sharedmemory.h"
+
+#include "config/global_options.h"
+#include "log/log.h"
+
+#include <windows.h>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+namespace bridge_util {
+
+  namespace {
+    constexpr uint32_t kMask = InputRing::kCapacity - 1;
+
+    SharedMemory* gpSharedMemory = nullptr;
+    // Released by the client when it waits for room, wakes the drain thread early
+    NamedSemaphore* gpDrainRequest = nullptr;
+#ifdef REMIX_BRIDGE_CLIENT
+    // Serializes the producer threads
+    std::mutex gPushMutex;
+#else
+    // Serializes the per frame drain and the drain thread
+    std::mutex gDrainMutex;
+    std::thread gDrainThread;
+    std::atomic<bool> gbStopDrain = false;
+#endif
+  }
+
+  InputRing::Block* InputRing::s_pBlock = nullptr;
+
+  void InputRing::init() {
+    if (!GlobalOptions::getInputRing() || gpSharedMemory) {
+      return;
+    }
+
+    // Both processes map the same zero-initialized block, whichever comes
+    // first stamps the header
+    gpSharedMemory = new SharedMemory(kSharedMemoryName, sizeof(Block));
+    Block* const pBlock = static_cast<Block*>(gpSharedMemory->data());
+    memcpy(pBlock->magic, kMagic, sizeof(kMagic));
+    pBlock->version = kVersion;
+    s_pBlock = pBlock;
+
+    gpDrainRequest = new NamedSemaphore("InputRingDrain", 0, 1);
+#ifndef REMIX_BRIDGE_CLIENT
+    gDrainThread = std::thread([]() {
+      while (!gbStopDrain.load(std::memory_order_acquire)) {
+        gpDrainRequest->wait(kDrainIntervalMs);
+        drain();
+      }
+    });
+#endif
+  }
+
+#ifndef REMIX_BRIDGE_CLIENT
+  void InputRing::shutdown() {
+    if (gDrainThread.joinable()) {
+      gbStopDrain.store(true, std::memory_order_release);
+      gpDrainRequest->release();
+      gDrainThread.join();
+    }
+  }
+#endif
+
+#ifdef REMIX_BRIDGE_CLIENT
+  bool InputRing::append(const uint32_t targetThreadId, const Event& event) {
+    const uint32_t writePos = s_pBlock->writePos.load(std::memory_order_relaxed);
+    if (writePos - s_pBlock->readPos.load(std::memory_order_acquire) >= kCapacity) {
+      // Sending around the ring would overtake the queued input and dropping a
+      // key or button transition would leave it stuck, so wait for the server
+      gpDrainRequest->release();
+      const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(kFullWaitMs);
+      while (writePos - s_pBlock->readPos.load(std::memory_order_acquire) >= kCapacity) {
+        if (std::chrono::steady_clock::now() >= deadline) {
+          static bool bStallLogged = false;
+          if (!bStallLogged) {
+            Logger::warn("Input ring is full and the server is not draining it, sending input directly.");
+            bStallLogged = true;
+          }
+          return false;
+        }
+        Sleep(1);
+      }
+    }
+
+    s_pBlock->events[writePos & kMask] = event;
+    if (s_pBlock->targetThreadId.load(std::memory_order_relaxed) != targetThreadId) {
+      s_pBlock->targetThreadId.store(targetThreadId, std::memory_order_relaxed);
+    }
+    s_pBlock->writePos.store(writePos + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool InputRing::push(const uint32_t targetThreadId, const uint32_t msg, const uint32_t wParam, const uint32_t lParam) {
+    if (!isEnabled()) {
+      return false;
+    }
+
+    std::lock_guard<std::mutex> lock(gPushMutex);
+    const uint32_t writePos = s_pBlock->writePos.load(std::memory_order_relaxed);
+    const uint32_t readPos = s_pBlock->readPos.load(std::memory_order_acquire);
+    // Positions are absolute, so the next move that makes it in restores the cursor
+    if (msg == WM_MOUSEMOVE && writePos - readPos >= kMouseMoveLimit) {
+      return true;
+    }
+
+    return append(targetThreadId, Event { msg, wParam, lParam });
+  }
+
+  bool InputRing::pushBehindPending(const uint32_t targetThreadId, const uint32_t msg, const uint32_t wParam, const uint32_t lParam) {
+    if (!isEnabled()) {
+      return false;
+    }
+
+    std::lock_guard<std::mutex> lock(gPushMutex);
+    const uint32_t writePos = s_pBlock->writePos.load(std::memory_order_relaxed);
+    const uint32_t readPos = s_pBlock->readPos.load(std::memory_order_acquire);
+    if (writePos == readPos) {
+      return false;
+    }
+
+    return append(targetThreadId, Event { msg, wParam, lParam });
+  }
+#else
+  uint32_t InputRing::drain() {
+    if (!isEnabled()) {
+      return 0;
+    }
+
+    std::lock_guard<std::mutex> lock(gDrainMutex);
+    const uint32_t writePos = s_pBlock->writePos.load(std::memory_order_acquire);
+    const uint32_t readPos = s_pBlock->readPos.load(std::memory_order_relaxed);
+    if (writePos == readPos) {
+      return 0;
+    }
+
+    const DWORD targetThreadId = s_pBlock->targetThreadId.load(std::memory_order_relaxed);
+    uint32_t numPosted = 0;
+    for (uint32_t pos = readPos; pos != writePos; ++pos) {
+      const Event& event = s_pBlock->events[pos & kMask];
+      // Mouse move positions are absolute, so a run of moves with the same
+      // button state is equivalent to its last one with all deltas applied
+      if (event.msg == WM_MOUSEMOVE && pos + 1 != writePos) {
+        const Event& next = s_pBlock->events[(pos + 1) & kMask];
+        if (next.msg == WM_MOUSEMOVE && next.wParam == event.wParam) {
+          continue;
+        }
+      }
+      if (targetThreadId != 0) {
+        PostThreadMessage(targetThreadId, event.msg, event.wParam, event.lParam);
+        ++numPosted;
+      }
+    }
+    s_pBlock->readPos.store(writePos, std::memory_order_release);
+    return numPosted;
+  }
+#endif
+
+}
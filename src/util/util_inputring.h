@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace bridge_util {
+
+  // Ring in shared memory carrying input window messages from the client to
+  // the server. Sending each event with PostThreadMessage floods the renderer
+  // message queue when a mouse polls at several kHz. The client instead
+  // appends events here, and the server drains the ring once per frame as well
+  // as periodically from a thread of its own, so input keeps flowing while the
+  // game does not present. Queued events are forwarded to the renderer message
+  // thread with runs of mouse moves collapsed into the last one. Control
+  // messages keep using the message channel, unless input is pending in the
+  // ring, in which case they queue up behind it to stay in order.
+  // Events come from the window proc as well as from the DirectInput hooks on
+  // whatever thread the game polls from, so pushes are serialized by a client
+  // side lock, and the two server side drains by a server side one.
+  class InputRing {
+  public:
+    static constexpr const char* kSharedMemoryName = "BridgeInputRing";
+    static constexpr char kMagic[4] = { 'B', 'R', 'I', 'R' };
+    static constexpr uint32_t kVersion = 1;
+    // Enough for a few frames of 8kHz mouse input at low frame rates
+    static constexpr uint32_t kCapacity = 4096;
+    // Mouse moves are dropped beyond this fill level, keeping the rest of the
+    // ring for button and key transitions, which must not be lost
+    static constexpr uint32_t kMouseMoveLimit = kCapacity / 4 * 3;
+    static_assert((kCapacity & (kCapacity - 1)) == 0, "Ring capacity must be a power of two");
+    // Interval of the server drain thread
+    static constexpr uint32_t kDrainIntervalMs = 10;
+    // How long a push waits for the server to make room in a full ring
+    static constexpr uint32_t kFullWaitMs = 1000;
+
+    struct Event {
+      uint32_t msg;
+      uint32_t wParam;
+      uint32_t lParam;
+    };
+
+    struct Block {
+      char magic[4];
+      uint32_t version;
+      // Written by the producers only, under the client side lock
+      alignas(64) std::atomic<uint32_t> writePos;
+      // Thread the consumer forwards the events to
+      std::atomic<uint32_t> targetThreadId;
+      // Written by the consumer only
+      alignas(64) std::atomic<uint32_t> readPos;
+      alignas(64) Event events[kCapacity];
+    };
+
+    static void init();
+#ifndef REMIX_BRIDGE_CLIENT
+    // Stops the drain thread
+    static void shutdown();
+#endif
+
+    static bool isEnabled() {
+      return s_pBlock != nullptr;
+    }
+
+#ifdef REMIX_BRIDGE_CLIENT
+    // Queues an input message for the given thread. Mouse moves are dropped
+    // when the ring is mostly full, every other message waits for the server
+    // to make room. Returns false if the ring is disabled, or if the server
+    // did not drain it within kFullWaitMs, in which case the caller must send
+    // the message itself.
+    static bool push(const uint32_t targetThreadId, const uint32_t msg, const uint32_t wParam, const uint32_t lParam);
+    // Queues a non-input message behind any input still pending in the ring,
+    // so it can't overtake that input, waiting for room like push() does.
+    // Returns false if nothing is pending, or for the same reasons as push(),
+    // in which case the caller must send it itself.
+    static bool pushBehindPending(const uint32_t targetThreadId, const uint32_t msg, const uint32_t wParam, const uint32_t lParam);
+#else
+    // Forwards all queued events to the target thread, returns the number of
+    // messages posted
+    static uint32_t drain();
+#endif
+
+  private:
+#ifdef REMIX_BRIDGE_CLIENT
+    // Appends an event once there is room, the push lock must be held
+    static bool append(const uint32_t targetThreadId, const Event& event);
+#endif
+    static Block* s_pBlock;
+  };
+
+}
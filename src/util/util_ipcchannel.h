@@ -47,7 +47,8 @@ public:
     , serverDataPos(static_cast<int64_t*>(sharedMem->data()))
     , clientDataExpectedPos(serverDataPos + 1)
     , serverResetPosRequired(reinterpret_cast<bool*>(clientDataExpectedPos + 1))
-    // Offsetting shared memory to account for 3 pointers used above
+    , writerFrameCount(reinterpret_cast<std::atomic<uint32_t>*>(clientDataExpectedPos + 1) + 1)
+    // Offsetting shared memory to account for the 4 pointers used above
     , commands(new CommandQueue(name + "Command",
                                 reinterpret_cast<void*>(
                                   reinterpret_cast<uintptr_t>(sharedMem->data()) +
@@ -70,6 +71,7 @@ public:
       *serverDataPos = -1;
       *clientDataExpectedPos = -1;
       *serverResetPosRequired = false;
+      new(writerFrameCount) std::atomic<uint32_t>(0);
     }
   }
 
@@ -94,15 +96,18 @@ public:
   int64_t*                           serverDataPos;
   int64_t*                           clientDataExpectedPos;
   bool*                              serverResetPosRequired;
+  // Number of frames presented by the writer, lets the reader tell how far ahead the writer is
+  std::atomic<uint32_t>*             writerFrameCount;
   CommandQueue* const                commands;
   bridge_util::DataQueue* const      data;
   bridge_util::NamedSemaphore* const dataSemaphore;
   std::atomic<bool>* const           pbCmdInProgress;
   mutable std::mutex                 m_mutex;
 
-  // Extra storage needed for data queue synchronization params
+  // Extra storage needed for data queue synchronization params. serverResetPosRequired
+  // is padded to 4 bytes to keep writerFrameCount aligned.
   static constexpr size_t kReservedSpace = align<size_t>(sizeof(*serverDataPos) +
-    sizeof(*clientDataExpectedPos) + sizeof(*serverResetPosRequired), 64);
+    sizeof(*clientDataExpectedPos) + sizeof(uint32_t) + sizeof(*writerFrameCount), 64);
 };
 using WriterChannel = IpcChannel<bridge_util::Accessor::Writer>;
 using ReaderChannel = IpcChannel<bridge_util::Accessor::Reader>;
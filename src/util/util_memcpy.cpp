@@ -0,0 +1,209 @@
+/*
+ * Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#include "util_memcpy.h"
+
+#include "log/log.h"
+
+#include <intrin.h>
+#include <immintrin.h>
+
+#include <cstdint>
+#include <cstring>
+
+namespace bridge_util {
+
+  namespace {
+    // Below this size streaming stores are not worth losing the cache for
+    constexpr size_t kNonTemporalThreshold = 4 * 1024;
+
+    using CopyKernel = void(*)(void* dst, const void* src, size_t size);
+
+    // Copies the unaligned head with memcpy so that the streaming loop
+    // always stores to Alignment-aligned destination addresses.
+    template<size_t Alignment>
+    inline size_t copyHead(uint8_t*& d, const uint8_t*& s, size_t size) {
+      const size_t head = (Alignment - ((uintptr_t) d & (Alignment - 1))) & (Alignment - 1);
+      const size_t n = head < size ? head : size;
+      memcpy(d, s, n);
+      d += n;
+      s += n;
+      return size - n;
+    }
+
+    void copySSE2(void* dst, const void* src, size_t size) {
+      auto* d = static_cast<uint8_t*>(dst);
+      auto* s = static_cast<const uint8_t*>(src);
+      size = copyHead<16>(d, s, size);
+      for (; size >= 64; size -= 64, d += 64, s += 64) {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 16));
+        const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 32));
+        const __m128i e = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 48));
+        _mm_stream_si128(reinterpret_cast<__m128i*>(d), a);
+        _mm_stream_si128(reinterpret_cast<__m128i*>(d + 16), b);
+        _mm_stream_si128(reinterpret_cast<__m128i*>(d + 32), c);
+        _mm_stream_si128(reinterpret_cast<__m128i*>(d + 48), e);
+      }
+      memcpy(d, s, size);
+    }
+
+    void copyAVX2(void* dst, const void* src, size_t size) {
+      auto* d = static_cast<uint8_t*>(dst);
+      auto* s = static_cast<const uint8_t*>(src);
+      size = copyHead<32>(d, s, size);
+      for (; size >= 128; size -= 128, d += 128, s += 128) {
+        const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s));
+        const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + 32));
+        const __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + 64));
+        const __m256i e = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + 96));
+        _mm256_stream_si256(reinterpret_cast<__m256i*>(d), a);
+        _mm256_stream_si256(reinterpret_cast<__m256i*>(d + 32), b);
+        _mm256_stream_si256(reinterpret_cast<__m256i*>(d + 64), c);
+        _mm256_stream_si256(reinterpret_cast<__m256i*>(d + 96), e);
+      }
+      memcpy(d, s, size);
+      // Avoid AVX-SSE transition penalties in the code that follows
+      _mm256_zeroupper();
+    }
+
+    void copyAVX512(void* dst, const void* src, size_t size) {
+      auto* d = static_cast<uint8_t*>(dst);
+      auto* s = static_cast<const uint8_t*>(src);
+      size = copyHead<64>(d, s, size);
+      for (; size >= 256; size -= 256, d += 256, s += 256) {
+        const __m512i a = _mm512_loadu_si512(s);
+        const __m512i b = _mm512_loadu_si512(s + 64);
+        const __m512i c = _mm512_loadu_si512(s + 128);
+        const __m512i e = _mm512_loadu_si512(s + 192);
+        _mm512_stream_si512(reinterpret_cast<__m512i*>(d), a);
+        _mm512_stream_si512(reinterpret_cast<__m512i*>(d + 64), b);
+        _mm512_stream_si512(reinterpret_cast<__m512i*>(d + 128), c);
+        _mm512_stream_si512(reinterpret_cast<__m512i*>(d + 192), e);
+      }
+      memcpy(d, s, size);
+      _mm256_zeroupper();
+    }
+
+    struct KernelInfo {
+      CopyKernel kernel;
+      const char* name;
+    };
+
+    KernelInfo selectKernel() {
+      int info[4];
+      __cpuid(info, 0);
+      const int maxLeaf = info[0];
+
+      __cpuid(info, 1);
+      const bool bOsxsave = (info[2] & (1 << 27)) != 0;
+      const bool bAvx = (info[2] & (1 << 28)) != 0;
+      const uint64_t xcr0 = bOsxsave ? _xgetbv(0) : 0;
+      // OS must preserve XMM/YMM, and additionally opmask/ZMM state for AVX-512
+      const bool bYmmEnabled = (xcr0 & 0x6) == 0x6;
+      const bool bZmmEnabled = (xcr0 & 0xe6) == 0xe6;
+
+      bool bAvx2 = false;
+      bool bAvx512 = false;
+      if (maxLeaf >= 7) {
+        __cpuidex(info, 7, 0);
+        bAvx2 = (info[1] & (1 << 5)) != 0;
+        bAvx512 = (info[1] & (1 << 16)) != 0;
+      }
+
+      if (bAvx && bAvx512 && bZmmEnabled) {
+        return { copyAVX512, "AVX-512" };
+      }
+      if (bAvx && bAvx2 && bYmmEnabled) {
+        return { copyAVX2, "AVX2" };
+      }
+      return { copySSE2, "SSE2" };
+    }
+
+    const KernelInfo& getKernel() {
+      static const KernelInfo kernel = [] {
+        const KernelInfo k = selectKernel();
+        Logger::info(format_string("Using %s non-temporal copy kernel", k.name));
+        return k;
+      }();
+      return kernel;
+    }
+
+    // Streaming stores are weakly ordered, callers must _mm_sfence() before the
+    // destination is handed back to the runtime.
+    inline void streamCopy(void* dst, const void* src, const size_t size) {
+      getKernel().kernel(dst, src, size);
+    }
+  }
+
+  const char* getFastMemcpyKernelName() {
+    return getKernel().name;
+  }
+
+  void fastMemcpy(void* dst, const void* src, const size_t size) {
+    if (size < kNonTemporalThreshold) {
+      memcpy(dst, src, size);
+      return;
+    }
+    streamCopy(dst, src, size);
+    _mm_sfence();
+  }
+
+  void fastCopyRows(void* dst, const size_t dstPitch,
+                    const void* src, const size_t srcPitch,
+                    const size_t rowSize, const size_t numRows) {
+    if (numRows == 0 || rowSize == 0) {
+      return;
+    }
+    if (dstPitch == rowSize && srcPitch == rowSize) {
+      fastMemcpy(dst, src, rowSize * numRows);
+      return;
+    }
+    auto* d = static_cast<uint8_t*>(dst);
+    auto* s = static_cast<const uint8_t*>(src);
+    if (rowSize * numRows < kNonTemporalThreshold) {
+      for (size_t y = 0; y < numRows; ++y) {
+        memcpy(d + y * dstPitch, s + y * srcPitch, rowSize);
+      }
+      return;
+    }
+    for (size_t y = 0; y < numRows; ++y) {
+      streamCopy(d + y * dstPitch, s + y * srcPitch, rowSize);
+    }
+    _mm_sfence();
+  }
+
+  void fastCopyBox(void* dst, const size_t dstRowPitch, const size_t dstSlicePitch,
+                   const void* src, const size_t srcRowPitch, const size_t srcSlicePitch,
+                   const size_t rowSize, const size_t numRows, const size_t numSlices) {
+    const size_t sliceSize = rowSize * numRows;
+    if (dstRowPitch == rowSize && srcRowPitch == rowSize &&
+        dstSlicePitch == sliceSize && srcSlicePitch == sliceSize) {
+      fastMemcpy(dst, src, sliceSize * numSlices);
+      return;
+    }
+    auto* d = static_cast<uint8_t*>(dst);
+    auto* s = static_cast<const uint8_t*>(src);
+    for (size_t z = 0; z < numSlices; ++z) {
+      fastCopyRows(d + z * dstSlicePitch, dstRowPitch, s + z * srcSlicePitch, srcRowPitch, rowSize, numRows);
+    }
+  }
+}
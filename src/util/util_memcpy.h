@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+
+#include <cstddef>
+
+namespace bridge_util {
+
+  // Copy routines for writing into memory mapped by the D3D runtime, which is often
+  // write-combined or uncached. Large copies bypass the cache with non-temporal stores
+  // using the widest kernel supported by the CPU, which is selected once at runtime.
+  // Smaller copies fall back to plain memcpy.
+
+  void fastMemcpy(void* dst, const void* src, const size_t size);
+
+  // Copies numRows rows of rowSize bytes between pitched images.
+  // Collapses into a single copy when the rows are contiguous on both sides.
+  void fastCopyRows(void* dst, const size_t dstPitch,
+                    const void* src, const size_t srcPitch,
+                    const size_t rowSize, const size_t numRows);
+
+  // Copies numSlices slices of numRows rows of rowSize bytes between pitched volumes.
+  // Collapses into per-slice or a single copy wherever the layout is contiguous.
+  void fastCopyBox(void* dst, const size_t dstRowPitch, const size_t dstSlicePitch,
+                   const void* src, const size_t srcRowPitch, const size_t srcSlicePitch,
+                   const size_t rowSize, const size_t numRows, const size_t numSlices);
+
+  // Name of the copy kernel picked for this CPU, for logging purposes.
+  const char* getFastMemcpyKernelName();
+}
@@ -143,6 +143,10 @@ namespace UTIL_NS {
       return m_serverThreadId != 0;
     }
 
+    uint32_t getServerThreadId() const {
+      return m_serverThreadId;
+    }
+
   private:
     uint32_t m_serverThreadId = 0;
   };
@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#include "util_metrics.h"
+#include "util_guid.h"
+#include "util_sharedmemory.h"
+
+#include "config/global_options.h"
+#include "log/log.h"
+
+#include <windows.h>
+#include <cstring>
+
+extern bridge_util::Guid gUniqueIdentifier;
+
+namespace bridge_util {
+
+  namespace {
+#ifdef REMIX_BRIDGE_CLIENT
+    constexpr Metrics::Process kProcess = Metrics::Process::Client;
+#else
+    constexpr Metrics::Process kProcess = Metrics::Process::Server;
+#endif
+
+    SharedMemory* gpSharedMemory = nullptr;
+    uint64_t gFrameIndex = 0;
+    uint64_t gFrameStart = 0;
+    uint64_t gFrequency = 0;
+    std::atomic<bool> gbPublishing = false;
+
+    uint64_t queryCounter() {
+      LARGE_INTEGER counter;
+      QueryPerformanceCounter(&counter);
+      return (uint64_t) counter.QuadPart;
+    }
+
+    void snapshot(const std::atomic<uint64_t>& src, uint64_t& dst) {
+      dst = src.load(std::memory_order_relaxed);
+    }
+
+    void consume(std::atomic<uint64_t>& src, uint64_t& dst) {
+      dst = src.exchange(0, std::memory_order_relaxed);
+    }
+  }
+
+  Metrics::LiveCounters Metrics::s_counters;
+  Metrics::Section* Metrics::s_pSection = nullptr;
+
+  void Metrics::init() {
+    if (!GlobalOptions::getLiveMetrics() || gpSharedMemory) {
+      return;
+    }
+
+    gpSharedMemory = new SharedMemory(kSharedMemoryName, sizeof(Block));
+    Block* const pBlock = static_cast<Block*>(gpSharedMemory->data());
+    memcpy(pBlock->magic, kMagic, sizeof(kMagic));
+    pBlock->version = kVersion;
+
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    gFrequency = (uint64_t) frequency.QuadPart;
+    gFrameStart = queryCounter();
+
+    Section* const pSection = &pBlock->sections[(uint32_t) kProcess];
+    pSection->processId = GetCurrentProcessId();
+    s_pSection = pSection;
+    Logger::info("Publishing live metrics, watch them with: NvRemixBridgeMetrics.exe " +
+                 gUniqueIdentifier.toString());
+  }
+
+  void Metrics::endFrame() {
+    if (!isEnabled()) {
+      return;
+    }
+    // The section has exactly one writer, if two threads present at the same
+    // time the second one simply leaves its counters to the next frame
+    if (gbPublishing.exchange(true, std::memory_order_acquire)) {
+      return;
+    }
+
+    Frame frame;
+    frame.frameIndex = gFrameIndex++;
+    frame.timestamp = queryCounter();
+    frame.frameTimeUs = (frame.timestamp - gFrameStart) * 1000000 / gFrequency;
+    gFrameStart = frame.timestamp;
+    for (uint32_t i = 0; i < (uint32_t) Channel::Count; ++i) {
+      auto& live = s_counters.channels[i];
+      auto& counters = frame.channels[i];
+      consume(live.commands, counters.commands);
+      consume(live.bytes, counters.bytes);
+      consume(live.dataQueueHighWater, counters.dataQueueHighWater);
+      consume(live.overwriteStalls, counters.overwriteStalls);
+      consume(live.pushRetries, counters.pushRetries);
+    }
+    consume(s_counters.presentWaitUs, frame.presentWaitUs);
+    snapshot(s_counters.sharedHeapBytes, frame.sharedHeapBytes);
+    snapshot(s_counters.sharedHeapSegments, frame.sharedHeapSegments);
+    snapshot(s_counters.allowedLead, frame.allowedLead);
+    snapshot(s_counters.framesInFlight, frame.framesInFlight);
+
+    const uint32_t sequence = s_pSection->sequence.load(std::memory_order_relaxed);
+    s_pSection->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    s_pSection->frame = frame;
+    s_pSection->sequence.store(sequence + 2, std::memory_order_release);
+
+    gbPublishing.store(false, std::memory_order_release);
+  }
+
+}
@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace bridge_util {
+
+  // Live bridge health counters. The client and the server each accumulate
+  // counters over a frame and publish them at Present into their own section
+  // of a small shared memory block, which can be watched while the game runs
+  // with the NvRemixBridgeMetrics tool. Each section has a single writer and is
+  // protected by a sequence lock, so neither side ever blocks on the other or
+  // on a reader.
+  class Metrics {
+  public:
+    enum class Channel : uint32_t {
+      Module = 0,
+      Device = 1,
+      Count
+    };
+
+    enum class Process : uint32_t {
+      Client = 0,
+      Server = 1,
+      Count
+    };
+
+    struct ChannelCounters {
+      uint64_t commands;
+      uint64_t bytes;
+      // Highest number of bytes written but not yet read by the other side
+      uint64_t dataQueueHighWater;
+      // Number of times syncDataQueue() had to wait for the reader to catch up
+      uint64_t overwriteStalls;
+      uint64_t pushRetries;
+    };
+
+    // Counters of the most recently completed frame
+    struct Frame {
+      uint64_t frameIndex;
+      // QueryPerformanceCounter value at the end of the frame
+      uint64_t timestamp;
+      uint64_t frameTimeUs;
+      ChannelCounters channels[(uint32_t) Channel::Count];
+      uint64_t presentWaitUs;
+      uint64_t sharedHeapBytes;
+      uint64_t sharedHeapSegments;
+      // Frames the client may be ahead of the server, as chosen by adaptive present pacing
+      uint64_t allowedLead;
+      uint64_t framesInFlight;
+    };
+
+    struct alignas(64) Section {
+      // Odd while the owning process is writing the frame
+      std::atomic<uint32_t> sequence;
+      uint32_t processId;
+      Frame frame;
+    };
+
+    static constexpr char kMagic[4] = { 'B', 'R', 'M', 'T' };
+    static constexpr uint32_t kVersion = 2;
+    static constexpr char kSharedMemoryName[] = "BridgeMetrics";
+    static constexpr uint32_t kMaxReadAttempts = 64;
+
+    struct Block {
+      char magic[4];
+      uint32_t version;
+      Section sections[(uint32_t) Process::Count];
+    };
+
+    // Maps the shared metrics block if the liveMetrics option is enabled
+    static void init();
+
+    static bool isEnabled() {
+      return s_pSection != nullptr;
+    }
+
+    static inline void addCommand(const Channel channel, const uint64_t bytes, const uint32_t retries) {
+      if (isEnabled()) {
+        auto& counters = s_counters.channels[(uint32_t) channel];
+        counters.commands.fetch_add(1, std::memory_order_relaxed);
+        counters.bytes.fetch_add(bytes, std::memory_order_relaxed);
+        if (retries > 0) {
+          counters.pushRetries.fetch_add(retries, std::memory_order_relaxed);
+        }
+      }
+    }
+
+    static inline void updateDataQueueOccupancy(const Channel channel, const uint64_t bytes) {
+      if (isEnabled()) {
+        auto& highWater = s_counters.channels[(uint32_t) channel].dataQueueHighWater;
+        uint64_t current = highWater.load(std::memory_order_relaxed);
+        while (bytes > current &&
+               !highWater.compare_exchange_weak(current, bytes, std::memory_order_relaxed)) {
+        }
+      }
+    }
+
+    static inline void addOverwriteStall(const Channel channel) {
+      if (isEnabled()) {
+        s_counters.channels[(uint32_t) channel].overwriteStalls.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+
+    static inline void addPresentWait(const uint64_t microseconds) {
+      if (isEnabled()) {
+        s_counters.presentWaitUs.fetch_add(microseconds, std::memory_order_relaxed);
+      }
+    }
+
+    static inline void setSharedHeapUsage(const uint64_t bytes, const uint64_t segments) {
+      if (isEnabled()) {
+        s_counters.sharedHeapBytes.store(bytes, std::memory_order_relaxed);
+        s_counters.sharedHeapSegments.store(segments, std::memory_order_relaxed);
+      }
+    }
+
+    static inline void setPresentPacing(const uint64_t allowedLead, const uint64_t framesInFlight) {
+      if (isEnabled()) {
+        s_counters.allowedLead.store(allowedLead, std::memory_order_relaxed);
+        s_counters.framesInFlight.store(framesInFlight, std::memory_order_relaxed);
+      }
+    }
+
+    // Publishes the counters accumulated since the previous call and starts a new frame
+    static void endFrame();
+
+    // Copies a consistent snapshot of a section, returns false if the writer
+    // kept it busy for every attempt
+    static bool readSection(const Section& section, Frame& frame) {
+      for (uint32_t attempt = 0; attempt < kMaxReadAttempts; ++attempt) {
+        const uint32_t before = section.sequence.load(std::memory_order_acquire);
+        if (before & 1) {
+          continue;
+        }
+        frame = section.frame;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (section.sequence.load(std::memory_order_relaxed) == before) {
+          return true;
+        }
+      }
+      return false;
+    }
+
+  private:
+    struct LiveChannelCounters {
+      std::atomic<uint64_t> commands = 0;
+      std::atomic<uint64_t> bytes = 0;
+      std::atomic<uint64_t> dataQueueHighWater = 0;
+      std::atomic<uint64_t> overwriteStalls = 0;
+      std::atomic<uint64_t> pushRetries = 0;
+    };
+
+    struct LiveCounters {
+      LiveChannelCounters channels[(uint32_t) Channel::Count];
+      std::atomic<uint64_t> presentWaitUs = 0;
+      std::atomic<uint64_t> sharedHeapBytes = 0;
+      std::atomic<uint64_t> sharedHeapSegments = 0;
+      std::atomic<uint64_t> allowedLead = 0;
+      std::atomic<uint64_t> framesInFlight = 0;
+    };
+
+    static LiveCounters s_counters;
+    static Section* s_pSection;
+  };
+
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+
+#include "util_commands.h"
+#include "../tracy/tracy.hpp"
+
+#include <array>
+#include <utility>
+
+// Opens a Tracy zone named after a bridge command. Every command has its own
+// static source location, so naming the zone costs nothing at runtime.
+#ifdef TRACY_ENABLE
+#define ZoneScopedCommand(command) \
+  tracy::ScopedZone ___tracy_scoped_zone(bridge_util::getCommandSourceLocation(command), true)
+#else
+#define ZoneScopedCommand(command)
+#endif
+
+// Names of the plots the bridge reports to Tracy
+namespace PlotNames {
+  constexpr const char* CommandQueueOccupancy = "Command queue occupancy";
+  constexpr const char* DataQueueOccupancy = "Data queue occupancy (bytes)";
+  constexpr const char* SharedHeapAllocated = "SharedHeap allocated (bytes)";
+  constexpr const char* SharedHeapSegments = "SharedHeap segments";
+  constexpr const char* ClientLead = "Client lead (frames)";
+  constexpr const char* AllowedLead = "Allowed client lead (frames)";
+}
+
+#ifdef TRACY_ENABLE
+namespace bridge_util {
+
+  namespace detail {
+    template<size_t... Ids>
+    constexpr std::array<tracy::SourceLocationData, sizeof...(Ids)>
+    makeCommandSourceLocations(std::index_sequence<Ids...>) {
+      return { {
+        { Commands::toCString((Commands::D3D9Command) Ids), "ProcessCommand", __FILE__, (uint32_t) __LINE__, 0 }...
+      } };
+    }
+
+    inline constexpr auto kCommandSourceLocations =
+      makeCommandSourceLocations(std::make_index_sequence<Commands::Bridge_CommandCount>());
+
+    inline constexpr tracy::SourceLocationData kTerminateSourceLocation {
+      Commands::toCString(Commands::Bridge_Terminate), "ProcessCommand", __FILE__, (uint32_t) __LINE__, 0
+    };
+
+    inline constexpr tracy::SourceLocationData kUnknownSourceLocation {
+      "Unknown Command", "ProcessCommand", __FILE__, (uint32_t) __LINE__, 0
+    };
+  }
+
+  inline const tracy::SourceLocationData* getCommandSourceLocation(const Commands::D3D9Command command) {
+    if (command < Commands::Bridge_CommandCount) {
+      return &detail::kCommandSourceLocations[command];
+    }
+    if (command == Commands::Bridge_Terminate) {
+      return &detail::kTerminateSourceLocation;
+    }
+    return &detail::kUnknownSourceLocation;
+  }
+
+}
+#endif
@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#include "util_queryresults.h"
+#include "util_sharedmemory.h"
+
+#include "log/log.h"
+
+#include <d3d9.h>
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+namespace bridge_util {
+
+  namespace {
+    SharedMemory* gpSharedMemory = nullptr;
+
+#ifdef REMIX_BRIDGE_CLIENT
+    std::mutex gSlotMutex;
+    std::vector<uint32_t> gFreeSlots;
+    uint32_t gNextUnusedSlot = 0;
+#endif
+  }
+
+  QueryResults::Block* QueryResults::s_pBlock = nullptr;
+
+  void QueryResults::init() {
+    if (gpSharedMemory) {
+      return;
+    }
+
+    // Both processes map the same zero-initialized block, whichever comes
+    // first stamps the header. A zero tag never matches, since generations
+    // start at one.
+    gpSharedMemory = new SharedMemory(kSharedMemoryName, sizeof(Block));
+    Block* const pBlock = static_cast<Block*>(gpSharedMemory->data());
+    memcpy(pBlock->magic, kMagic, sizeof(kMagic));
+    pBlock->version = kVersion;
+    s_pBlock = pBlock;
+  }
+
+#ifdef REMIX_BRIDGE_CLIENT
+  uint32_t QueryResults::acquireSlot(const uint32_t queryType) {
+    if (!isEnabled()) {
+      return kNoSlot;
+    }
+    switch (queryType) {
+    case D3DQUERYTYPE_EVENT:
+    case D3DQUERYTYPE_OCCLUSION:
+    case D3DQUERYTYPE_TIMESTAMP:
+    case D3DQUERYTYPE_TIMESTAMPDISJOINT:
+    case D3DQUERYTYPE_TIMESTAMPFREQ:
+      break;
+    default:
+      return kNoSlot;
+    }
+
+    std::scoped_lock lock(gSlotMutex);
+    if (!gFreeSlots.empty()) {
+      const uint32_t slot = gFreeSlots.back();
+      gFreeSlots.pop_back();
+      return slot;
+    }
+    if (gNextUnusedSlot < kNumSlots) {
+      return gNextUnusedSlot++;
+    }
+    static bool bExhaustedLogged = false;
+    if (!bExhaustedLogged) {
+      Logger::warn("All query result slots are in use, further queries are read back synchronously.");
+      bExhaustedLogged = true;
+    }
+    return kNoSlot;
+  }
+
+  void QueryResults::releaseSlot(const uint32_t slot) {
+    if (slot == kNoSlot) {
+      return;
+    }
+    std::scoped_lock lock(gSlotMutex);
+    gFreeSlots.push_back(slot);
+  }
+
+  bool QueryResults::read(const uint32_t slot, const uint32_t handle, const uint32_t generation,
+                          void* pData, const uint32_t size, int32_t& hresult) {
+    const Slot& s = s_pBlock->slots[slot];
+    const uint64_t tag = makeTag(handle, generation);
+    if (s.tag.load(std::memory_order_acquire) != tag) {
+      return false;
+    }
+    hresult = s.hresult;
+    if (pData && size > 0 && hresult == S_OK) {
+      memcpy(pData, s.data, std::min(size, s.size));
+    }
+    // The slot may have been overwritten while copying, e.g. by a result of
+    // a later issue racing with this read
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return s.tag.load(std::memory_order_relaxed) == tag;
+  }
+#else
+  void QueryResults::write(const uint32_t slot, const uint32_t handle, const uint32_t generation,
+                           const int32_t hresult, const void* pData, const uint32_t size) {
+    if (!isEnabled() || slot >= kNumSlots) {
+      return;
+    }
+    Slot& s = s_pBlock->slots[slot];
+    // Invalidate first so a concurrent reader cannot match a half written slot
+    s.tag.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    s.hresult = hresult;
+    s.size = std::min(size, kMaxDataSize);
+    if (pData && s.size > 0) {
+      memcpy(s.data, pData, s.size);
+    }
+    s.tag.store(makeTag(handle, generation), std::memory_order_release);
+  }
+#endif
+
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace bridge_util {
+
+  // Shared memory slots through which the server pushes the results of
+  // polled queries (event, occlusion, timestamp) to the client. Games spin
+  // on IDirect3DQuery9::GetData every frame, which used to be a synchronous
+  // round trip each time. Instead the client assigns each such query a slot
+  // and the server polls the issued queries itself, publishing the result
+  // once it is available, so GetData becomes a local read.
+  //
+  // Each slot is tagged with the query handle and the number of times the
+  // query was issued with D3DISSUE_END, which both sides count identically.
+  // A result only matches when both agree, so stale results from an earlier
+  // issue or from a previous owner of the slot are never returned.
+  class QueryResults {
+  public:
+    static constexpr const char* kSharedMemoryName = "BridgeQueryResults";
+    static constexpr char kMagic[4] = { 'B', 'R', 'Q', 'R' };
+    static constexpr uint32_t kVersion = 1;
+    static constexpr uint32_t kNumSlots = 4096;
+    static constexpr uint32_t kNoSlot = 0xFFFFFFFF;
+    // Largest result of the query types that are pushed (UINT64 timestamps)
+    static constexpr uint32_t kMaxDataSize = 8;
+
+    struct Slot {
+      // (handle << 32) | generation, published last
+      std::atomic<uint64_t> tag;
+      int32_t hresult;
+      uint32_t size;
+      uint8_t data[kMaxDataSize];
+    };
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "Slot tags are shared between processes");
+    static_assert(sizeof(Slot) == 24, "Slot layout must match between the 32-bit client and the 64-bit server");
+
+    struct Block {
+      char magic[4];
+      uint32_t version;
+      alignas(64) Slot slots[kNumSlots];
+    };
+
+    static void init();
+
+    static bool isEnabled() {
+      return s_pBlock != nullptr;
+    }
+
+    static uint64_t makeTag(const uint32_t handle, const uint32_t generation) {
+      return (static_cast<uint64_t>(handle) << 32) | generation;
+    }
+
+#ifdef REMIX_BRIDGE_CLIENT
+    // Returns a free slot for a query of the given type, or kNoSlot if its
+    // results are not pushed
+    static uint32_t acquireSlot(const uint32_t queryType);
+    static void releaseSlot(const uint32_t slot);
+    // Copies the result of the given issue if the server has published it.
+    // Returns false if it has not yet.
+    static bool read(const uint32_t slot, const uint32_t handle, const uint32_t generation,
+                     void* pData, const uint32_t size, int32_t& hresult);
+#else
+    static void write(const uint32_t slot, const uint32_t handle, const uint32_t generation,
+                      const int32_t hresult, const void* pData, const uint32_t size);
+#endif
+
+  private:
+    static Block* s_pBlock;
+  };
+
+}
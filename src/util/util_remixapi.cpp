@@ -45,8 +45,21 @@ namespace {
 // Convenience function templates to help with the boilerplate necessary
 // to handle deserializing the `const T*` RemixApi struct member pattern
 
+// Under a DeserializeArena::Scope, raw memcpy'd data is viewed in place when
+// it is suitably aligned, and copied into the arena otherwise.
 template<typename T>
 static inline void deserialize_const_p(void*& pDeserialize, const T*& deserializeTo, const uint32_t size) {
+  if (auto* const pArena = bridge_util::DeserializeArena::current()) {
+    if ((reinterpret_cast<uintptr_t>(pDeserialize) % alignof(T)) == 0) {
+      deserializeTo = static_cast<const T*>(pDeserialize);
+      pDeserialize = static_cast<uint8_t*>(pDeserialize) + size;
+    } else {
+      T* arena_arr = static_cast<T*>(pArena->allocate(size, alignof(T)));
+      bridge_util::deserialize(pDeserialize, arena_arr, size);
+      deserializeTo = arena_arr;
+    }
+    return;
+  }
   T* new_arr = (T*) new uint8_t[size];
   bridge_util::deserialize(pDeserialize, new_arr, size);
   deserializeTo = new_arr;
@@ -54,7 +67,8 @@ static inline void deserialize_const_p(void*& pDeserialize, const T*& deserializ
 
 template<typename T>
 static inline void deserialize_const_p_for_each(void*& pDeserialize, const T*& deserializeTo, const size_t num) {
-  T* new_arr = (T*) new T[num];
+  auto* const pArena = bridge_util::DeserializeArena::current();
+  T* new_arr = pArena ? pArena->allocate<T>(num) : new T[num];
   for(size_t i = 0; i < num; ++i) {
     bridge_util::deserialize(pDeserialize, new_arr[i]);
   }
@@ -121,6 +135,17 @@ void deserialize(void*& deserializeFrom, remixapi_Path& deserializeTo) {
   if(bIsValidString) {
     const uint32_t size = pathSize(reinterpret_cast<const remixapi_Path&>(deserializeFrom));
     assert(size <= MAX_PATH);
+    if (auto* const pArena = DeserializeArena::current()) {
+      if ((reinterpret_cast<uintptr_t>(deserializeFrom) % alignof(wchar_t)) == 0) {
+        deserializeTo = static_cast<remixapi_Path>(deserializeFrom);
+        deserializeFrom = static_cast<uint8_t*>(deserializeFrom) + size;
+        return;
+      }
+      auto arenaStr = static_cast<wchar_t*>(pArena->allocate(size, alignof(wchar_t)));
+      deserialize(deserializeFrom, arenaStr, size);
+      deserializeTo = arenaStr;
+      return;
+    }
     auto intermediate = new wchar_t[size];
     deserialize(deserializeFrom, intermediate, size);
     deserializeTo = intermediate;
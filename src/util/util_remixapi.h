@@ -129,6 +129,16 @@ template<> constexpr auto ToRemixApiStructEnum< remixapi_CameraInfo
 template<> constexpr auto ToRemixApiStructEnum< remixapi_CameraInfoParameterizedEXT     > = REMIXAPI_STRUCT_TYPE_CAMERA_INFO_PARAMETERIZED_EXT;
 
 
+// RemixApi_DrawInstanceBatch carries several remixapi_InstanceInfo at once.
+// After the instance count, each fixed size field is sent as its own array:
+// categoryFlags, mesh handle uids, transforms, doubleSided and the offset of
+// each instance's extension chain into the extension blob that follows. A
+// chain is a sequence of sType followed by the serialized extension, closed
+// by REMIXAPI_STRUCT_TYPE_NONE.
+namespace batch {
+static constexpr uint32_t kNoExtensions = 0xFFFFFFFF;
+}
+
 namespace serialize {
 // Type declaration
 
@@ -20,6 +20,7 @@
  * DEALINGS IN THE SOFTWARE.
  */
 #include "util_seh.h"
+#include "util_apitrace.h"
 #include "util_filesys.h"
 #include "log/log.h"
 
@@ -68,6 +69,8 @@ static LONG WINAPI BridgeExceptionHandler(PEXCEPTION_POINTERS pExceptionPointers
           pExceptionPointers->ExceptionRecord->ExceptionAddress,
           dumpFilename);
 
+  ApiTrace::dump();
+
   if (hFile != INVALID_HANDLE_VALUE) {
     MINIDUMP_EXCEPTION_INFORMATION ei;
 
@@ -21,6 +21,8 @@
  */
 #pragma once
 
+#include "util_arena.h"
+
 #include <assert.h>
 #include <stdint.h>
 #include <array>
@@ -54,8 +56,9 @@ public:
     // Static sized struct implies POD with no variable length pointers.
     // Trivial implicit dtor sufficient
     if constexpr (!bHasStaticSize) {
-      // User code that serializes a given struct is in charge of freeing relevant memory
-      if(kType == Deserialize) {
+      // User code that serializes a given struct is in charge of freeing relevant memory,
+      // unless it came out of a DeserializeArena
+      if(kType == Deserialize && !m_bArenaBacked) {
         _dtor();
       }
     }
@@ -66,6 +69,7 @@ public:
     kType = other.kType;
     m_kSize = other.m_kSize;
     m_pDeserializeMe = other.m_pDeserializeMe;
+    m_bArenaBacked = other.m_bArenaBacked;
     other.kType = Invalid;
     other.m_kSize = 0;
     other.m_pDeserializeMe = nullptr;
@@ -99,6 +103,7 @@ public:
     uint32_t deserializedSize = 0;
     bridge_util::deserialize(pDeserialize, deserializedSize);
     assert(deserializedSize == size());
+    m_bArenaBacked = DeserializeArena::current() != nullptr;
     _deserialize(pDeserialize);
     const auto endPos = reinterpret_cast<uintptr_t>(pDeserialize);
     assert((endPos - startPos) == size());
@@ -142,6 +147,7 @@ private:
   } kType = Invalid;
   void* m_pDeserializeMe = nullptr;
   uint32_t m_kSize = 0;
+  bool m_bArenaBacked = false;
 public:
   static inline const uint32_t s_kSize = initStaticSize();
 };
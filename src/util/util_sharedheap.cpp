@@ -23,6 +23,8 @@
 
 #include "util_bytes.h"
 #include "util_devicecommand.h"
+#include "util_metrics.h"
+#include "util_profiling.h"
 #include "config/global_options.h"
 
 #include <assert.h>
@@ -45,7 +47,8 @@ SharedHeap::Instance::Instance()
   : m_chunkSize(GlobalOptions::getSharedHeapChunkSize())
   , m_defaultSegmentSize(GlobalOptions::getSharedHeapDefaultSegmentSize())
   , m_nChunks(0)
-  , m_metaShMem("SharedHeap_meta", (kMax32BitHeapSize / m_chunkSize)) {
+  , m_metaShMem("SharedHeap_meta", (kMax32BitHeapSize / m_chunkSize))
+  , m_fenceShMem("SharedHeap_fence", sizeof(std::atomic<Fence>)) {
 #ifdef REMIX_BRIDGE_CLIENT
   assert(GlobalOptions::getUseSharedHeap());
   assert(m_defaultSegmentSize % m_chunkSize == 0);
@@ -118,6 +121,7 @@ bool SharedHeap::Instance::addNewHeapSegment() {
     const auto& newSeg = m_segments[newSegId];
     m_mapChunkToSeg[newSegId] = newSeg.getBaseChunkId();
     m_nChunks += newSeg.getNumChunks();
+    reportUsage();
   } else {
     Logger::err("[SharedHeap][addNewHeapSegment] Failed to create new SharedHeap segment. Crash may be imminent.");
   }
@@ -191,6 +195,7 @@ SharedHeap::AllocId SharedHeap::Instance::allocate(const size_t size) {
 
   const size_t sizeAllocated = numChunks * m_chunkSize;
   m_sizeAllocated += sizeAllocated;
+  reportUsage();
 #ifdef _DEBUG
   memset(getBuf(id), 0, sizeAllocated);
 #endif
@@ -199,6 +204,46 @@ SharedHeap::AllocId SharedHeap::Instance::allocate(const size_t size) {
 void SharedHeap::Instance::deallocate(const AllocId id) {
   ClientMessage c(Commands::Bridge_SharedHeap_Dealloc, id);
 }
+
+SharedHeap::Fence SharedHeap::Instance::issueFence() {
+  // Skip the null fence on wrap-around so that it always reads as signaled
+  if (++m_lastIssuedFence == kNullFence) {
+    ++m_lastIssuedFence;
+  }
+  return m_lastIssuedFence;
+}
+
+bool SharedHeap::Instance::isFenceSignaled(const Fence fence) const {
+  if (fence == kNullFence) {
+    return true;
+  }
+  const Fence signaled = getSignaledFence().load(std::memory_order_acquire);
+  // Wrap-safe comparison, fences are issued and signaled strictly in order
+  return static_cast<int32_t>(signaled - fence) >= 0;
+}
+
+bool SharedHeap::Instance::waitForFence(const Fence fence) const {
+  const auto timeoutStart = GetTickCount64();
+  uint32_t nSpins = 0;
+  while (!isFenceSignaled(fence)) {
+    if (!gbBridgeRunning) {
+      return false;
+    }
+    const auto dt = GetTickCount64() - timeoutStart;
+    if (dt / 1000 >= GlobalOptions::getSharedHeapFreeChunkWaitTimeout()) {
+      Logger::warn(format_string("[SharedHeap][waitForFence] Timeout waiting on fence %u!", fence));
+      return false;
+    }
+    // Spin briefly since the server is typically only a few commands behind,
+    // then back off to not starve the server process of CPU time
+    if (++nSpins < 64) {
+      YieldProcessor();
+    } else {
+      Sleep(0);
+    }
+  }
+  return true;
+}
 #endif
 
 #ifdef REMIX_BRIDGE_SERVER
@@ -212,6 +257,9 @@ void SharedHeap::Instance::deallocate(const AllocId id) {
   setChunkState(firstChunk, ChunkState::Deallocated);
   m_cache.erase(id);
 }
+void SharedHeap::Instance::signalFence(const Fence fence) {
+  getSignaledFence().store(fence, std::memory_order_release);
+}
 #endif
 
 #ifdef REMIX_BRIDGE_CLIENT
@@ -295,6 +343,12 @@ SharedHeap::Instance::findFreeOnEnd(const size_t numChunks) {
   return createAllocation(firstFreeEndChunk, numChunks);
 }
 
+void SharedHeap::Instance::reportUsage() const {
+  Metrics::setSharedHeapUsage(m_sizeAllocated, m_segments.size());
+  TracyPlot(PlotNames::SharedHeapAllocated, (int64_t) m_sizeAllocated);
+  TracyPlot(PlotNames::SharedHeapSegments, (int64_t) m_segments.size());
+}
+
 void SharedHeap::Instance::freeDeallocations() {
   std::vector<AllocId> deallocatedIds;
   for (const auto [id, firstChunk] : m_cache) {
@@ -312,6 +366,7 @@ void SharedHeap::Instance::freeDeallocations() {
     setChunkState(firstChunk, ChunkState::Unallocated);
     m_sizeAllocated -= numChunks * m_chunkSize;
   }
+  reportUsage();
 }
 
 bool SharedHeap::Instance::isValidAllocation(const Allocation& alloc) {
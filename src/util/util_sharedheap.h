@@ -24,6 +24,7 @@
 #include "util_common.h"
 #include "util_sharedmemory.h"
 
+#include <atomic>
 #include <unordered_map>
 #include <map>
 
@@ -34,6 +35,10 @@ namespace bridge_util {
     static constexpr Id kInvalidId = (Id) -1;
     using AllocId = Id;
     using ChunkId = Id;
+    // Monotonic counter the server bumps once it is done reading a SharedHeap
+    // allocation, letting the client recycle the allocation without a round trip.
+    using Fence = uint32_t;
+    static constexpr Fence kNullFence = 0;
 
     static void init();
     static BYTE* getBuf(const AllocId id) {
@@ -46,6 +51,15 @@ namespace bridge_util {
     static void deallocate(const AllocId id) {
       get().deallocate(id);
     }
+    static Fence issueFence() {
+      return get().issueFence();
+    }
+    static bool isFenceSignaled(const Fence fence) {
+      return get().isFenceSignaled(fence);
+    }
+    static bool waitForFence(const Fence fence) {
+      return get().waitForFence(fence);
+    }
 #endif
 #ifdef REMIX_BRIDGE_SERVER
     static void allocate(const AllocId id, const ChunkId firstChunk) {
@@ -57,6 +71,9 @@ namespace bridge_util {
     static void addNewHeapSegment(const uint32_t segmentSize) {
       get().addNewHeapSegment(segmentSize);
     }
+    static void signalFence(const Fence fence) {
+      get().signalFence(fence);
+    }
 #endif
 
   private:
@@ -71,11 +88,15 @@ namespace bridge_util {
 #ifdef REMIX_BRIDGE_CLIENT
       AllocId allocate(const size_t size);
       void deallocate(const AllocId id);
+      Fence issueFence();
+      bool isFenceSignaled(const Fence fence) const;
+      bool waitForFence(const Fence fence) const;
 #endif
 #ifdef REMIX_BRIDGE_SERVER
       void allocate(const AllocId id, const ChunkId firstChunk);
       void deallocate(const AllocId id);
       void addNewHeapSegment(const uint32_t segmentSize);
+      void signalFence(const Fence fence);
 #endif
 
     private:
@@ -91,6 +112,7 @@ namespace bridge_util {
       AllocId m_nextUid = 0;
       std::map<ChunkId, ChunkId> m_allocations;
       size_t m_sizeAllocated = 0;
+      Fence m_lastIssuedFence = kNullFence;
 #endif
 
       // Delete other ctors
@@ -114,6 +136,7 @@ namespace bridge_util {
       Allocation findFreeInMiddle(const size_t numChunks);
       Allocation findFreeOnEnd(const size_t numChunks);
       void freeDeallocations();
+      void reportUsage() const;
       bool isValidAllocation(const Allocation& alloc);
       bool allocationCrossesHeapSegBound(const Allocation& alloc);
 #endif
@@ -136,6 +159,10 @@ namespace bridge_util {
 
       // Shared Memory members
       SharedMemory m_metaShMem;
+      SharedMemory m_fenceShMem;
+      std::atomic<Fence>& getSignaledFence() const {
+        return *static_cast<std::atomic<Fence>*>(m_fenceShMem.data());
+      }
       class Segment {
       public:
         Segment(const std::string shMemName,